@@ -0,0 +1,72 @@
+#version 450 core
+
+// shades the cells straight into the framebuffer, the same as
+// compute_shader.glsl does into the output texture
+
+in vec2 p_uv;
+
+out vec4 o_color;
+
+uniform uvec2 cell_size;
+uniform uvec2 grid_size;
+uniform uint screen_height;
+uniform uint blink_hidden;
+uniform uint glyph_map_cols;
+
+const uint GLYPH_INVERT = 0x1;
+const uint GLYPH_BLINK = 0x2;
+
+struct Cell
+{
+   uint glyph_colors;
+   uint flags;
+};
+
+layout(std430, binding=3) buffer cells_buffer {
+   Cell cells[];
+};
+
+layout(std140, binding=4) uniform palette_buffer {
+   vec4 palette[16];
+};
+
+layout(binding=1) uniform sampler2D glyph_map;
+
+void
+main()
+{
+   // rows start at the top of the window
+   uvec2 pixel = uvec2(gl_FragCoord.x, screen_height - 1u - uint(gl_FragCoord.y));
+
+   if (pixel.x >= cell_size.x * grid_size.x || pixel.y >= cell_size.y * grid_size.y) {
+      o_color = vec4(0.0, 0.0, 0.0, 1.0);
+      return;
+   }
+
+   uvec2 cell_index = pixel / cell_size;
+   uvec2 cell_pos = pixel % cell_size;
+
+   Cell cell = cells[cell_index.x + cell_index.y * grid_size.x];
+
+   uint glyph = cell.glyph_colors & 0xffffu;
+   uvec2 glyph_pos = uvec2(glyph % glyph_map_cols, glyph / glyph_map_cols) * cell_size;
+
+   vec4 texel = texelFetch(glyph_map, ivec2(glyph_pos + cell_pos), 0);
+
+   vec3 fg = palette[(cell.glyph_colors >> 16u) & 0xffu].rgb;
+   vec3 bg = palette[cell.glyph_colors >> 24u].rgb;
+
+   uint flags = cell.flags & 0xffu;
+   if ((flags & GLYPH_BLINK) != 0u && blink_hidden != 0u) {
+      flags &= ~GLYPH_INVERT;
+   }
+
+   vec3 invert = vec3(flags & GLYPH_INVERT);
+
+   fg = abs(invert - fg);
+   bg = abs(invert - bg);
+
+   vec3 color = mix(bg, fg, texel.rgb);
+
+   o_color = vec4(pow(color, vec3(1.0 / 1.8)), 1.0);
+}
@@ -1,39 +1,46 @@
 #version 450 core
 
 layout(local_size_x=16, local_size_y=16, local_size_z=1) in;
-layout(rgba32f, binding=0) uniform image2D output_texture;
+// the editor defines it to the format of the output texture
+#ifndef OUTPUT_FORMAT
+#define OUTPUT_FORMAT rgba32f
+#endif
+
+layout(OUTPUT_FORMAT, binding=0) uniform image2D output_texture;
 
 uniform uvec2 cell_size;
 uniform uvec2 grid_size;
+uniform uint blink_hidden;
+// corner of the dirty tiles this dispatch covers
+uniform uvec2 pixel_offset;
 
 const uint GLYPH_INVERT = 0x1;
 const uint GLYPH_BLINK = 0x2;
 
+uniform uint glyph_map_cols;
+
+// glyph in the low 16 bits, then the fg and bg palette indices, flags in
+// the low byte of the second word
 struct Cell
 {
-   uint glyph;
-   uint fg;
-   uint bg;
+   uint glyph_colors;
+   uint flags;
 };
 
 layout(std430, binding=3) buffer cells_buffer {
    Cell cells[];
 };
 
-layout(binding=1) uniform sampler2D glyph_map;
+layout(std140, binding=4) uniform palette_buffer {
+   vec4 palette[16];
+};
 
-vec3 unpack_color(uint c)
-{
-   int r = int((c >> 16u) & 0xffu);
-   int g = int((c >> 8u) & 0xffu);
-   int b = int(c & 0xffu);
-   return vec3(r, g, b) / 255.0;
-}
+layout(binding=1) uniform sampler2D glyph_map;
 
 void
 main()
 {
-   uvec2 pixel = gl_GlobalInvocationID.xy;
+   uvec2 pixel = gl_GlobalInvocationID.xy + pixel_offset;
 
    if (pixel.x >= cell_size.x * grid_size.x || pixel.y >= cell_size.y * grid_size.y) {
       return;
@@ -44,16 +51,21 @@ main()
 
    Cell cell = cells[cell_index.x + cell_index.y * grid_size.x];
 
-   uvec2 glyph_pos = uvec2((cell.glyph >> 16) & 0xffffu, cell.glyph & 0xffffu) * cell_size;
+   uint glyph = cell.glyph_colors & 0xffffu;
+   uvec2 glyph_pos = uvec2(glyph % glyph_map_cols, glyph / glyph_map_cols) * cell_size;
 
    uvec2 pixel_pos = glyph_pos + cell_pos;
 
    vec4 texel = texelFetch(glyph_map, ivec2(pixel_pos), 0);
 
-   vec3 fg = unpack_color(cell.fg);
-   vec3 bg = unpack_color(cell.bg);
+   vec3 fg = palette[(cell.glyph_colors >> 16u) & 0xffu].rgb;
+   vec3 bg = palette[cell.glyph_colors >> 24u].rgb;
+
+   uint flags = cell.flags & 0xffu;
+   if ((flags & GLYPH_BLINK) != 0u && blink_hidden != 0u) {
+      flags &= ~GLYPH_INVERT;
+   }
 
-   uint flags = (cell.bg >> 24u) & 0xffu;
    vec3 invert = vec3(flags & GLYPH_INVERT);
 
    fg = abs(invert - fg);
@@ -123,6 +123,24 @@ typedef int32_t  B32;
 
 #define NOT_IMPLEMENTED ASSERT("Not Implemented!")
 
+// loads acquire and stores release, enough to publish data between threads
+#if COMPILER_MSVC
+#include <intrin.h>
+#define atomic_load_u32(p)     ((U32)_InterlockedOr((volatile long *)(p), 0))
+#define atomic_store_u32(p, v) ((void)_InterlockedExchange((volatile long *)(p), (long)(v)))
+#define atomic_exchange_u32(p, v) ((U32)_InterlockedExchange((volatile long *)(p), (long)(v)))
+#define atomic_load_u64(p)     ((U64)_InterlockedOr64((volatile __int64 *)(p), 0))
+#define atomic_store_u64(p, v) ((void)_InterlockedExchange64((volatile __int64 *)(p), (__int64)(v)))
+#define atomic_exchange_ptr(p, v) _InterlockedExchangePointer((void *volatile *)(p), (void *)(v))
+#else
+#define atomic_load_u32(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define atomic_store_u32(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define atomic_exchange_u32(p, v) __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#define atomic_load_u64(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define atomic_store_u64(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define atomic_exchange_ptr(p, v) __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#endif
+
 #define ALIGN_POW2(x, b) (((x) + (b)-1) & (~((b)-1)))
 #define IS_POW2(x)      ((x) != 0 && ((x) & ((x)-1)) == 0)
 
@@ -4,29 +4,280 @@
 
 #include "base_os.h"
 
+#if ARENA_STATS
+
+global ArenaStats arena_stats[ARENA_STATS_MAX];
+global U32 arena_stats_lock;
+
+intern void
+lock_arena_stats()
+{
+   while (atomic_exchange_u32(&arena_stats_lock, 1)) {
+   }
+}
+
+intern void
+unlock_arena_stats()
+{
+   atomic_store_u32(&arena_stats_lock, 0);
+}
+
+intern B32
+arena_stats_released(ArenaStats *s)
+{
+   for (; s; s = s->parent) {
+      if (s->released) {
+         return 1;
+      }
+   }
+
+   return 0;
+}
+
+intern void
+arena_stats_begin(Arena *a, Arena *parent)
+{
+   lock_arena_stats();
+
+   ArenaStats *s = 0;
+   for (U32 i = 0; i < ARENA_STATS_MAX && !s; ++i) {
+      if (!arena_stats[i].used) {
+         s = &arena_stats[i];
+      }
+   }
+   for (U32 i = 0; i < ARENA_STATS_MAX && !s; ++i) {
+      if (arena_stats[i].released) {
+         s = &arena_stats[i];
+      }
+   }
+
+   if (s) {
+      MEM_ZERO(s, sizeof(ArenaStats));
+      s->used = 1;
+      s->size = a->size;
+      s->parent = parent ? parent->stats : 0;
+   }
+
+   a->stats = s;
+
+   unlock_arena_stats();
+}
+
+intern void
+arena_stats_end(Arena *a)
+{
+   if (!a->stats) {
+      return;
+   }
+
+   lock_arena_stats();
+
+   // sub arenas go with their parent
+   a->stats->released = 1;
+   for (U32 i = 0; i < ARENA_STATS_MAX; ++i) {
+      if (arena_stats[i].used && arena_stats_released(&arena_stats[i])) {
+         arena_stats[i].released = 1;
+      }
+   }
+
+   unlock_arena_stats();
+}
+
+intern void
+arena_stats_push(Arena *a, U64 size)
+{
+   ArenaStats *s = a->stats;
+   if (!s) {
+      return;
+   }
+
+   U32 bucket = 0;
+   while (bucket + 1 < ARENA_HISTOGRAM_BUCKETS && (size >> (bucket + 1))) {
+      bucket++;
+   }
+
+   s->push_count++;
+   s->push_bytes += size;
+   s->histogram[bucket]++;
+   s->peak_top = MAX(s->peak_top, a->top);
+   s->peak_commit = MAX(s->peak_commit, a->commit);
+}
+
+intern const char *
+arena_stats_name(ArenaStats *s)
+{
+   return s->name ? s->name : "unnamed";
+}
+
+void
+arena_set_name(Arena *a, const char *name)
+{
+   if (a->stats) {
+      a->stats->name = name;
+   }
+}
+
+void
+log_arena_stats()
+{
+   lock_arena_stats();
+
+   log_info("Arena stats (KB):");
+
+   for (U32 i = 0; i < ARENA_STATS_MAX; ++i) {
+      ArenaStats *s = &arena_stats[i];
+      if (!s->used) {
+         continue;
+      }
+
+      char sizes[512];
+      int len = 0;
+      for (U32 b = 0; b < ARENA_HISTOGRAM_BUCKETS; ++b) {
+         if (s->histogram[b] && len < (int) sizeof(sizes)) {
+            len += snprintf(sizes + len, sizeof(sizes) - len, " %llu:%llu",
+                            1ull << b, (unsigned long long) s->histogram[b]);
+         }
+      }
+
+      log_info("  %s%s%s%s: %llu reserved, peak %llu used %llu committed, %llu pushes of %llu, temp depth %u",
+               arena_stats_name(s), s->parent ? " in " : "", s->parent ? arena_stats_name(s->parent) : "",
+               s->released ? " (released)" : "",
+               (unsigned long long) (s->size >> 10), (unsigned long long) (s->peak_top >> 10),
+               (unsigned long long) (s->peak_commit >> 10), (unsigned long long) s->push_count,
+               (unsigned long long) (s->push_bytes >> 10), s->peak_temp_depth);
+
+      if (len) {
+         log_info("    pushes by size in bytes from:%s", sizes);
+      }
+   }
+
+   for (U32 i = 0; i < ARENA_STATS_MAX; ++i) {
+      ArenaStats *s = &arena_stats[i];
+
+      if (s->used && !s->released && !s->parent) {
+         log_info("  leak: %s still reserves %llu", arena_stats_name(s), (unsigned long long) (s->size >> 10));
+      }
+      if (s->used && !s->released && s->temp_depth) {
+         log_info("  leak: %s has %u temps not ended", arena_stats_name(s), s->temp_depth);
+      }
+   }
+
+   unlock_arena_stats();
+}
+
+#else
+
+void
+arena_set_name(Arena *a, const char *name)
+{
+}
+
+void
+log_arena_stats()
+{
+}
+
+#endif
+
+// commits the pages that overlap [from, to)
+intern void
+arena_commit_range(U8 *from, U8 *to)
+{
+   U64 page = os_page_size();
+   U8 *start = (U8 *) ((U64) from & ~(page - 1));
+
+   if (!os_commit(start, (U64) (to - start))) {
+      log_fatal("Failed to commit %llu bytes", (unsigned long long) (to - start));
+   }
+}
+
+intern U64
+arena_large_page(U64 size)
+{
+   return size >= ARENA_LARGE_PAGE_THRESHOLD ? os_large_page_size() : 0;
+}
+
+// a large page is only used when all of it is committed at once
+intern U64
+arena_commit_step(U64 size)
+{
+   return MAX(arena_large_page(size), (U64) ARENA_COMMIT_SIZE);
+}
+
 void
 init_arena(Arena *a, U64 size)
 {
    a->size = size;
    a->top = 0;
-   a->ptr = (U8 *) os_reserve(size);
-   
-   // this might not be optimal on linux and macos
-   os_commit(a->ptr, size);
+   a->commit = 0;
+   a->sub_top = 0;
+
+   if (size >= ARENA_LARGE_PAGE_THRESHOLD) {
+      a->ptr = (U8 *) os_reserve_large(size);
+   } else {
+      a->ptr = (U8 *) os_reserve(size);
+   }
+
+   if (!a->ptr) {
+      log_fatal("Failed to reserve %llu bytes", (unsigned long long) size);
+   }
+
+#if ARENA_STATS
+   arena_stats_begin(a, 0);
+#endif
 }
 
 void
 free_arena(Arena *a, U64 size)
 {
    os_release(a->ptr, size);
+
+#if ARENA_STATS
+   arena_stats_end(a);
+#endif
+}
+
+intern U8 *
+arena_push_reserved(Arena *a, U64 size, U64 align)
+{
+   U64 base = (U64) (a->ptr + a->top);
+   U64 off = 0;
+
+   U64 mask = align - 1;
+   if (base & mask) {
+      off = align - (base & mask);
+   }
+
+   if_unlikely (a->top + off + size > a->size) {
+      log_fatal("Arena overflow: %llu bytes pushed onto %llu of %llu",
+                (unsigned long long) size, (unsigned long long) a->top, (unsigned long long) a->size);
+   }
+
+   a->top += off + size;
+
+   return (U8 *) (base + off);
 }
 
 void
 sub_arena(Arena *sub, Arena *a, U64 size)
 {
    sub->size = size;
-   sub->ptr = push_size(a, size);
+   // large sub arenas start on a large page so their commits line up with them
+   sub->ptr = arena_push_reserved(a, size, MAX(arena_large_page(size), (U64) 4));
    sub->top = 0;
+   sub->commit = 0;
+   sub->sub_top = 0;
+
+   // the sub arena commits its range itself
+   a->commit = MAX(a->commit, a->top);
+   a->sub_top = a->top;
+
+#if ARENA_STATS
+   arena_stats_begin(sub, a);
+   if (a->stats) {
+      a->stats->peak_top = MAX(a->stats->peak_top, a->top);
+   }
+#endif
 }
 
 TempArena
@@ -37,31 +288,134 @@ begin_temp_arena(Arena *a)
    ta.arena = a;
    ta.reset_top = a->top;
 
+#if ARENA_STATS
+   if (a->stats) {
+      a->stats->temp_depth++;
+      a->stats->peak_temp_depth = MAX(a->stats->peak_temp_depth, a->stats->temp_depth);
+   }
+#endif
+
    return ta;
 }
 
 void
-end_temp_arena(TempArena ta)
+end_temp_arena(TempArena ta, U64 keep)
+{
+   Arena *a = ta.arena;
+   a->top = ta.reset_top;
+
+#if ARENA_STATS
+   if (a->stats && a->stats->temp_depth) {
+      a->stats->temp_depth--;
+   }
+#endif
+
+   if (keep < a->size - a->top) {
+      // only whole pages inside the arena, the ones at the edges may be
+      // shared with memory next to it
+      U64 page = os_page_size();
+      U64 from = ALIGN_POW2((U64) (a->ptr + a->top + keep), page);
+      U64 to = MIN((U64) (a->ptr + a->commit), (U64) (a->ptr + a->size) & ~(page - 1));
+
+      if (from < to) {
+         os_decommit((void *) from, to - from);
+         a->commit = from - (U64) a->ptr;
+      }
+   }
+
+   // sub arenas taken since the temp began only committed what they used,
+   // pushes into their range commit it again
+   if (a->sub_top > a->top) {
+      a->commit = MIN(a->commit, a->top);
+      a->sub_top = a->top;
+   }
+}
+
+thread_local Arena scratch_arenas[SCRATCH_COUNT];
+
+TempArena
+get_scratch(Arena **conflicts, U32 conflict_count)
+{
+   Arena *scratch = 0;
+
+   for (U32 i = 0; i < SCRATCH_COUNT && !scratch; ++i) {
+      scratch = &scratch_arenas[i];
+
+      for (U32 j = 0; j < conflict_count; ++j) {
+         if (conflicts[j] == scratch) {
+            scratch = 0;
+            break;
+         }
+      }
+   }
+
+   ASSERT(scratch);
+
+   if (!scratch->ptr) {
+      init_arena(scratch, SCRATCH_ARENA_SIZE);
+      arena_set_name(scratch, "scratch");
+   }
+
+   return begin_temp_arena(scratch);
+}
+
+void
+release_scratch(TempArena scratch)
+{
+   end_temp_arena(scratch, SCRATCH_KEEP_SIZE);
+}
+
+void
+free_thread_scratch()
 {
-   ta.arena->top = ta.reset_top;
+   for (U32 i = 0; i < SCRATCH_COUNT; ++i) {
+      if (scratch_arenas[i].ptr) {
+         free_arena(&scratch_arenas[i], scratch_arenas[i].size);
+         scratch_arenas[i] = {};
+      }
+   }
 }
 
 U8 *
 push_size(Arena *a, U64 size, U64 align)
 {
-   U64 base = (U64) (a->ptr + a->top);
-   U64 off = 0;
+   U8 *ptr = arena_push_reserved(a, size, align);
 
-   U64 mask = align - 1;
-   if (base & mask) {
-      off = align - (base & mask);
+   if (a->top > a->commit) {
+      U64 commit = MIN(ALIGN_POW2(a->top, arena_commit_step(a->size)), a->size);
+      arena_commit_range(a->ptr + a->commit, a->ptr + commit);
+      a->commit = commit;
    }
 
-   size += off;
+#if ARENA_STATS
+   arena_stats_push(a, size);
+#endif
 
-   U8 *ptr = (U8 *) (base + off);
+   return ptr;
+}
 
-   a->top += size;
+U64
+commit_grow(U8 *base, U64 committed, U64 size, U64 cap)
+{
+   if (size <= committed) {
+      return committed;
+   }
 
-   return ptr;
+   U64 commit = MIN(ALIGN_POW2(size, arena_commit_step(cap)), cap);
+   arena_commit_range(base + committed, base + commit);
+
+   return commit;
+}
+
+U64
+commit_grow_down(U8 *end, U64 committed, U64 size, U64 cap)
+{
+   if (size <= committed) {
+      return committed;
+   }
+
+   U64 commit = MIN(ALIGN_POW2(size, arena_commit_step(cap)), cap);
+   arena_commit_range(end - commit, end - committed);
+
+   return commit;
 }
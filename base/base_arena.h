@@ -2,11 +2,53 @@
 
 #include "base.h"
 
+// -DARENA_STATS records how every arena is used, see log_arena_stats
+#ifndef ARENA_STATS
+#define ARENA_STATS 0
+#endif
+
+enum
+{
+   ARENA_COMMIT_SIZE = KILO_BYTES(64), // step in which reserved memory is committed
+   // larger arenas are reserved for large pages and commit a large page at a time
+   ARENA_LARGE_PAGE_THRESHOLD = MEGA_BYTES(256),
+   ARENA_STATS_MAX = 1024, // released records are reused once all are taken
+   ARENA_HISTOGRAM_BUCKETS = 24,
+   SCRATCH_COUNT = 2,
+   SCRATCH_ARENA_SIZE = GIGA_BYTES(1),
+   SCRATCH_KEEP_SIZE = MEGA_BYTES(4), // committed pages a scratch keeps after a release
+};
+
+struct ArenaStats
+{
+   const char *name;
+   ArenaStats *parent; // of a sub arena
+   U64 size;
+   U64 peak_top;
+   U64 peak_commit;
+   U64 push_count;
+   U64 push_bytes;
+   U64 histogram[ARENA_HISTOGRAM_BUCKETS]; // pushes by the log2 of their size
+   U32 temp_depth;
+   U32 peak_temp_depth;
+   B32 used;
+   B32 released;
+};
+
+// The memory of an arena is reserved up front and committed as top grows,
+// so untouched reservations cost neither RAM nor commit charge. Large arenas
+// are backed by large pages where the os allows, for fewer TLB misses when
+// gigabytes of text are scanned.
 struct Arena
 {
    U64 size;
    U64 top;
    U8 *ptr;
+   U64 commit; // bytes from ptr that are committed
+   U64 sub_top; // top after the last sub arena, which commits its range itself
+#if ARENA_STATS
+   ArenaStats *stats; // shared by the copies of the arena, 0 when the table was full
+#endif
 };
 
 struct TempArena
@@ -17,10 +59,32 @@ struct TempArena
 
 intern void init_arena(Arena *a, U64 size);
 intern void sub_arena(Arena *sub, Arena *a, U64 size);
+intern void free_arena(Arena *a, U64 size);
+
+// both do nothing without ARENA_STATS. The dump lists the peak use of every
+// arena and, as leaks, the ones not released and temps not ended.
+intern void arena_set_name(Arena *a, const char *name);
+intern void log_arena_stats();
 
 intern TempArena begin_temp_arena(Arena *a);
-intern void end_temp_arena(TempArena ta);
+// pages more than keep bytes above the reset top go back to the os
+intern void end_temp_arena(TempArena ta, U64 keep=max_U64);
+
+// Temporary memory of the calling thread, no locks involved. Every thread
+// has SCRATCH_COUNT arenas reserved on first use. Pass the arenas the caller
+// still pushes onto as conflicts, the scratch is one of the others, so a
+// function that got its output arena from a scratch user can take one too.
+intern TempArena get_scratch(Arena **conflicts=0, U32 conflict_count=0);
+intern void release_scratch(TempArena scratch);
+// threads that used scratch memory call this before they exit
+intern void free_thread_scratch();
 
 #define push_array(a, ty, n, ...) (ty *) push_size(a, n * sizeof(ty), ## __VA_ARGS__)
 #define push_struct(a, ty, ...) (ty *) push_size(a, sizeof(ty), ## __VA_ARGS__)
 intern U8 *push_size(Arena *a, U64 size, U64 align=4);
+
+// For memory that is written in place instead of pushed, like the text of
+// a gap buffer. Commits the first size of cap bytes behind base (or in
+// front of it, for the down variant) and returns how many are committed now.
+intern U64 commit_grow(U8 *base, U64 committed, U64 size, U64 cap);
+intern U64 commit_grow_down(U8 *end, U64 committed, U64 size, U64 cap);
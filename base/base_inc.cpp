@@ -1,4 +1,5 @@
 #include "base_arena.cpp"
+#include "base_pool.cpp"
 #include "base_os.cpp"
 #include "base_string.cpp"
 #include "base.cpp"
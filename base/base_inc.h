@@ -4,3 +4,4 @@
 #include "base_arena.h"
 #include "base_os.h"
 #include "base_string.h"
+#include "base_pool.h"
@@ -21,11 +21,41 @@ struct OS_FileInfo
 
 // Memory
 intern void *os_reserve(U64 size);
+// aligned to os_large_page_size, commits of whole large pages in it may be
+// backed by a single page each. A plain reservation without large pages.
+intern void *os_reserve_large(U64 size);
 intern B32 os_commit(void *ptr, U64 size);
 intern void os_decommit(void *ptr, U64 size);
 intern void os_release(void *ptr, U64 size);
 
 intern U64 os_page_size(void);
+// 0 when reserved memory cannot be backed by large pages
+intern U64 os_large_page_size(void);
+intern U32 os_processor_count(void);
+
+// Time
+intern U64 os_now_microseconds(void);
+// user and kernel time spent by all threads of the process
+intern U64 os_process_cpu_microseconds(void);
+
+// Threads
+typedef void OS_ThreadFunc(void *param);
+
+// returns 0 when the thread could not be started
+intern OS_Handle os_thread_start(OS_ThreadFunc *func, void *param);
+intern void os_thread_join(OS_Handle thread);
+
+intern OS_Handle os_mutex_alloc(void);
+intern void os_mutex_release(OS_Handle mutex);
+intern void os_mutex_lock(OS_Handle mutex);
+intern void os_mutex_unlock(OS_Handle mutex);
+
+// waits release the mutex while sleeping, they can wake up spuriously
+intern OS_Handle os_condvar_alloc(void);
+intern void os_condvar_release(OS_Handle cv);
+intern void os_condvar_wait(OS_Handle cv, OS_Handle mutex);
+intern void os_condvar_signal(OS_Handle cv);
+intern void os_condvar_broadcast(OS_Handle cv);
 
 // File Management
 intern OS_Handle os_open_file(String8 path, OS_Flags flags);
@@ -36,5 +66,12 @@ intern B32 os_file_is_valid(OS_Handle handle);
 
 intern String8 os_read(OS_Handle handle, U64 size, Arena *arena);
 
+// maps a whole file read-only, pages are only read in when touched
+intern String8 os_map_file(String8 path);
+intern void os_unmap_file(String8 mapped);
+
+// replaces the file as a whole, mappings of the old contents stay valid
+intern B32 os_write_file(String8 path, String8 data);
+
 // These functions are using the above platform specific functions
 intern String8 os_read_file(String8 path, Arena *arena);
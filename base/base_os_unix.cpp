@@ -3,14 +3,49 @@
 #include "base_string.h"
 
 #include <fcntl.h>
+#include <pthread.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 void *
 os_reserve(U64 size)
 {
-   return mmap(0, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   void *ptr = mmap(0, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   return ptr == MAP_FAILED ? 0 : ptr;
+}
+
+// Transparent huge pages. MAP_HUGETLB takes its pages from a pool that has
+// to be set up up front and faults with SIGBUS once it runs dry, that does
+// not go with committing as the arena grows.
+void *
+os_reserve_large(U64 size)
+{
+   U64 large = os_large_page_size();
+   if (!large) {
+      return os_reserve(size);
+   }
+
+   U64 span = size + large;
+   U8 *base = (U8 *) mmap(0, span, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (base == MAP_FAILED) {
+      return 0;
+   }
+
+   U8 *ptr = (U8 *) ALIGN_POW2((U64) base, large);
+   U8 *end = (U8 *) ALIGN_POW2((U64) (ptr + size), os_page_size());
+
+   if (ptr > base) {
+      munmap(base, ptr - base);
+   }
+   munmap(end, base + span - end);
+
+   // only a hint, the memory still works when the kernel ignores it
+   madvise(ptr, size, MADV_HUGEPAGE);
+
+   return ptr;
 }
 
 B32
@@ -38,6 +73,168 @@ os_page_size(void)
    return (U64)getpagesize();
 }
 
+global U64 os_large_page_cache = max_U64;
+
+U64
+os_large_page_size(void)
+{
+   U64 cached = atomic_load_u64(&os_large_page_cache);
+   if (cached != max_U64) {
+      return cached;
+   }
+
+   // madvise and always both let MADV_HUGEPAGE ranges use huge pages
+   U64 size = 0;
+   char mode[128] = {};
+
+   FILE *enabled = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+   if (enabled) {
+      if (fgets(mode, sizeof(mode), enabled) && !strstr(mode, "[never]")) {
+         FILE *pmd = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+         unsigned long long pmd_size = 0;
+
+         if (pmd && fscanf(pmd, "%llu", &pmd_size) == 1 && IS_POW2(pmd_size)) {
+            size = pmd_size;
+         }
+
+         if (pmd) {
+            fclose(pmd);
+         }
+      }
+
+      fclose(enabled);
+   }
+
+   atomic_store_u64(&os_large_page_cache, size);
+
+   return size;
+}
+
+U32
+os_processor_count(void)
+{
+   long count = sysconf(_SC_NPROCESSORS_ONLN);
+   return count > 0 ? (U32)count : 1;
+}
+
+U64
+os_now_microseconds(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (U64)ts.tv_sec * 1000000 + (U64)ts.tv_nsec / 1000;
+}
+
+U64
+os_process_cpu_microseconds(void)
+{
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+
+   U64 user = (U64)usage.ru_utime.tv_sec * 1000000 + (U64)usage.ru_utime.tv_usec;
+   U64 sys = (U64)usage.ru_stime.tv_sec * 1000000 + (U64)usage.ru_stime.tv_usec;
+
+   return user + sys;
+}
+
+struct OS_ThreadStart
+{
+   OS_ThreadFunc *func;
+   void *param;
+};
+
+intern void *
+os_thread_entry(void *p)
+{
+   OS_ThreadStart start = *(OS_ThreadStart *)p;
+   free(p);
+
+   start.func(start.param);
+   return 0;
+}
+
+OS_Handle
+os_thread_start(OS_ThreadFunc *func, void *param)
+{
+   OS_ThreadStart *start = (OS_ThreadStart *)malloc(sizeof(OS_ThreadStart));
+   start->func = func;
+   start->param = param;
+
+   pthread_t thread;
+   if (pthread_create(&thread, 0, os_thread_entry, start) != 0) {
+      free(start);
+      return 0;
+   }
+
+   return (OS_Handle)thread;
+}
+
+void
+os_thread_join(OS_Handle thread)
+{
+   pthread_join((pthread_t)thread, 0);
+}
+
+OS_Handle
+os_mutex_alloc(void)
+{
+   pthread_mutex_t *mutex = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t));
+   pthread_mutex_init(mutex, 0);
+   return (OS_Handle)mutex;
+}
+
+void
+os_mutex_release(OS_Handle mutex)
+{
+   pthread_mutex_destroy((pthread_mutex_t *)mutex);
+   free((void *)mutex);
+}
+
+void
+os_mutex_lock(OS_Handle mutex)
+{
+   pthread_mutex_lock((pthread_mutex_t *)mutex);
+}
+
+void
+os_mutex_unlock(OS_Handle mutex)
+{
+   pthread_mutex_unlock((pthread_mutex_t *)mutex);
+}
+
+OS_Handle
+os_condvar_alloc(void)
+{
+   pthread_cond_t *cv = (pthread_cond_t *)malloc(sizeof(pthread_cond_t));
+   pthread_cond_init(cv, 0);
+   return (OS_Handle)cv;
+}
+
+void
+os_condvar_release(OS_Handle cv)
+{
+   pthread_cond_destroy((pthread_cond_t *)cv);
+   free((void *)cv);
+}
+
+void
+os_condvar_wait(OS_Handle cv, OS_Handle mutex)
+{
+   pthread_cond_wait((pthread_cond_t *)cv, (pthread_mutex_t *)mutex);
+}
+
+void
+os_condvar_signal(OS_Handle cv)
+{
+   pthread_cond_signal((pthread_cond_t *)cv);
+}
+
+void
+os_condvar_broadcast(OS_Handle cv)
+{
+   pthread_cond_broadcast((pthread_cond_t *)cv);
+}
+
 OS_Handle
 os_open_file(String8 path, OS_Flags flags)
 {
@@ -110,3 +307,89 @@ os_read(OS_Handle handle, U64 size, Arena *arena)
    *end = 0;
    return result;
 }
+
+global U8 os_empty_mapping[1];
+
+String8
+os_map_file(String8 path)
+{
+   char *c_path = cstr_from_str8(path);
+   int fd = open(c_path, O_RDONLY);
+   free(c_path);
+
+   if (fd == -1) {
+      return null_str8;
+   }
+
+   struct stat statbuf;
+   if (fstat(fd, &statbuf) == -1) {
+      close(fd);
+      return null_str8;
+   }
+
+   String8 result = {};
+
+   // mmap can not map zero bytes
+   if (statbuf.st_size == 0) {
+      result.ptr = os_empty_mapping;
+   } else {
+      void *ptr = mmap(0, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (ptr != MAP_FAILED) {
+         madvise(ptr, statbuf.st_size, MADV_SEQUENTIAL);
+         result.ptr = (U8 *) ptr;
+         result.len = statbuf.st_size;
+      } else {
+         perror("mmap()");
+      }
+   }
+
+   // the mapping stays valid after the descriptor is closed
+   close(fd);
+   return result;
+}
+
+void
+os_unmap_file(String8 mapped)
+{
+   if (mapped.len) {
+      munmap(mapped.ptr, mapped.len);
+   }
+}
+
+B32
+os_write_file(String8 path, String8 data)
+{
+   char *c_path = cstr_from_str8(path);
+
+   char tmp_path[4096];
+   snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", c_path);
+
+   int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (fd == -1) {
+      free(c_path);
+      return 0;
+   }
+
+   U8 *ptr = data.ptr;
+   U8 *end = data.ptr + data.len;
+
+   while (ptr < end) {
+      ssize_t written = write(fd, ptr, end - ptr);
+      if (written == -1) {
+         perror("write()");
+         break;
+      }
+      ptr += written;
+   }
+
+   close(fd);
+
+   // the rename swaps the file in at once, readers never see half of it
+   B32 ok = ptr == end && rename(tmp_path, c_path) == 0;
+   if (!ok) {
+      unlink(tmp_path);
+   }
+
+   free(c_path);
+   return ok;
+}
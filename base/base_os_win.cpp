@@ -11,6 +11,14 @@ os_reserve(U64 size)
    return VirtualAlloc(0, size, MEM_RESERVE, PAGE_READWRITE);
 }
 
+// Large pages on Windows have to be committed together with the reservation
+// and are never paged out, arenas that commit as they grow cannot use them
+void *
+os_reserve_large(U64 size)
+{
+   return os_reserve(size);
+}
+
 B32
 os_commit(void *ptr, U64 size)
 {
@@ -38,6 +46,141 @@ os_page_size(void)
    return sys_info.dwPageSize;
 }
 
+U64
+os_large_page_size(void)
+{
+   return 0;
+}
+
+U32
+os_processor_count(void)
+{
+   SYSTEM_INFO sys_info = {};
+   GetSystemInfo(&sys_info);
+
+   return sys_info.dwNumberOfProcessors;
+}
+
+U64
+os_now_microseconds(void)
+{
+   LARGE_INTEGER freq, counter;
+   QueryPerformanceFrequency(&freq);
+   QueryPerformanceCounter(&counter);
+
+   return (U64)((counter.QuadPart / freq.QuadPart) * 1000000 + ((counter.QuadPart % freq.QuadPart) * 1000000) / freq.QuadPart);
+}
+
+U64
+os_process_cpu_microseconds(void)
+{
+   FILETIME creation, exit, kernel, user;
+   GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+
+   // in 100ns ticks
+   U64 k = ((U64)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+   U64 u = ((U64)user.dwHighDateTime << 32) | user.dwLowDateTime;
+
+   return (k + u) / 10;
+}
+
+struct OS_ThreadStart
+{
+   OS_ThreadFunc *func;
+   void *param;
+};
+
+intern DWORD WINAPI
+os_thread_entry(void *p)
+{
+   OS_ThreadStart start = *(OS_ThreadStart *)p;
+   free(p);
+
+   start.func(start.param);
+   return 0;
+}
+
+OS_Handle
+os_thread_start(OS_ThreadFunc *func, void *param)
+{
+   OS_ThreadStart *start = (OS_ThreadStart *)malloc(sizeof(OS_ThreadStart));
+   start->func = func;
+   start->param = param;
+
+   HANDLE thread = CreateThread(0, 0, os_thread_entry, start, 0, 0);
+   if (!thread) {
+      free(start);
+      return 0;
+   }
+
+   return (OS_Handle)thread;
+}
+
+void
+os_thread_join(OS_Handle thread)
+{
+   WaitForSingleObject((HANDLE)thread, INFINITE);
+   CloseHandle((HANDLE)thread);
+}
+
+OS_Handle
+os_mutex_alloc(void)
+{
+   SRWLOCK *mutex = (SRWLOCK *)malloc(sizeof(SRWLOCK));
+   InitializeSRWLock(mutex);
+   return (OS_Handle)mutex;
+}
+
+void
+os_mutex_release(OS_Handle mutex)
+{
+   free((void *)mutex);
+}
+
+void
+os_mutex_lock(OS_Handle mutex)
+{
+   AcquireSRWLockExclusive((SRWLOCK *)mutex);
+}
+
+void
+os_mutex_unlock(OS_Handle mutex)
+{
+   ReleaseSRWLockExclusive((SRWLOCK *)mutex);
+}
+
+OS_Handle
+os_condvar_alloc(void)
+{
+   CONDITION_VARIABLE *cv = (CONDITION_VARIABLE *)malloc(sizeof(CONDITION_VARIABLE));
+   InitializeConditionVariable(cv);
+   return (OS_Handle)cv;
+}
+
+void
+os_condvar_release(OS_Handle cv)
+{
+   free((void *)cv);
+}
+
+void
+os_condvar_wait(OS_Handle cv, OS_Handle mutex)
+{
+   SleepConditionVariableSRW((CONDITION_VARIABLE *)cv, (SRWLOCK *)mutex, INFINITE, 0);
+}
+
+void
+os_condvar_signal(OS_Handle cv)
+{
+   WakeConditionVariable((CONDITION_VARIABLE *)cv);
+}
+
+void
+os_condvar_broadcast(OS_Handle cv)
+{
+   WakeAllConditionVariable((CONDITION_VARIABLE *)cv);
+}
+
 OS_Handle
 os_open_file(String8 path, OS_Flags flags)
 {
@@ -129,3 +272,84 @@ os_read(OS_Handle handle, U64 size, Arena *arena)
 
    return result;
 }
+
+global U8 os_empty_mapping[1];
+
+String8
+os_map_file(String8 path)
+{
+   OS_Handle handle = os_open_file(path, OS_READ | OS_SHARED);
+   if (!os_file_is_valid(handle)) {
+      return null_str8;
+   }
+
+   String8 result = {};
+
+   OS_FileInfo file_info = os_file_info(handle);
+
+   // empty files can not be mapped
+   if (file_info.size == 0) {
+      result.ptr = os_empty_mapping;
+   } else {
+      HANDLE mapping = CreateFileMappingA((HANDLE)handle, 0, PAGE_READONLY, 0, 0, 0);
+      if (mapping) {
+         void *ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+         if (ptr) {
+            result.ptr = (U8 *) ptr;
+            result.len = file_info.size;
+         }
+
+         // the view keeps the mapping alive
+         CloseHandle(mapping);
+      }
+   }
+
+   os_close_file(handle);
+   return result;
+}
+
+void
+os_unmap_file(String8 mapped)
+{
+   if (mapped.len) {
+      UnmapViewOfFile(mapped.ptr);
+   }
+}
+
+B32
+os_write_file(String8 path, String8 data)
+{
+   char *c_path = cstr_from_str8(path);
+
+   char tmp_path[MAX_PATH];
+   snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", c_path);
+
+   HANDLE file = CreateFileA(tmp_path, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+   if (file == INVALID_HANDLE_VALUE) {
+      free(c_path);
+      return 0;
+   }
+
+   U8 *ptr = data.ptr;
+   U8 *end = data.ptr + data.len;
+
+   while (ptr < end) {
+      DWORD to_write = (DWORD)CLAMP_TOP((U64)(end - ptr), max_U32);
+      DWORD written = 0;
+      if (!WriteFile(file, ptr, to_write, &written, 0)) {
+         break;
+      }
+      ptr += written;
+   }
+
+   CloseHandle(file);
+
+   // fails while another instance has the old file mapped, it keeps its copy then
+   B32 ok = ptr == end && MoveFileExA(tmp_path, c_path, MOVEFILE_REPLACE_EXISTING);
+   if (!ok) {
+      DeleteFileA(tmp_path);
+   }
+
+   free(c_path);
+   return ok;
+}
@@ -0,0 +1,230 @@
+#include "base_pool.h"
+
+#include "sanitizer/asan_interface.h"
+
+// free items are poisoned as a whole, the link is only readable in between
+intern NKINLINE PoolItem *
+pool_item_next(PoolItem *item)
+{
+   ASAN_UNPOISON_MEMORY_REGION(item, sizeof(PoolItem));
+   PoolItem *next = item->next;
+   ASAN_POISON_MEMORY_REGION(item, sizeof(PoolItem));
+
+   return next;
+}
+
+intern NKINLINE PoolItem *
+pool_item_free(Pool *p, void *ptr, PoolItem *next)
+{
+   PoolItem *item = (PoolItem *) ptr;
+   item->next = next;
+   ASAN_POISON_MEMORY_REGION(item, p->item_size);
+
+   return item;
+}
+
+intern NKINLINE void *
+pool_item_alloc(Pool *p, PoolItem *item)
+{
+   ASAN_UNPOISON_MEMORY_REGION(item, p->item_size);
+   return item;
+}
+
+intern NKINLINE void
+pool_lock(Pool *p)
+{
+   if (p->mutex) {
+      os_mutex_lock(p->mutex);
+   }
+}
+
+intern NKINLINE void
+pool_unlock(Pool *p)
+{
+   if (p->mutex) {
+      os_mutex_unlock(p->mutex);
+   }
+}
+
+void
+init_pool(Pool *p, Arena arena, U64 item_size, B32 shared)
+{
+   MEM_ZERO(p, sizeof(Pool));
+   p->arena = arena;
+   p->item_size = ALIGN_POW2(MAX(item_size, sizeof(PoolItem)), (U64) 8);
+
+   if (shared) {
+      p->mutex = os_mutex_alloc();
+   }
+}
+
+void
+release_pool(Pool *p)
+{
+   if (p->mutex) {
+      os_mutex_release(p->mutex);
+      p->mutex = 0;
+   }
+
+   // the free items are part of the arena again
+   ASAN_UNPOISON_MEMORY_REGION(p->arena.ptr, p->arena.top);
+   p->free = 0;
+   p->free_count = 0;
+}
+
+void *
+pool_alloc(Pool *p)
+{
+   pool_lock(p);
+
+   void *item;
+   if (p->free) {
+      PoolItem *first = p->free;
+      p->free = pool_item_next(first);
+      p->free_count--;
+      item = pool_item_alloc(p, first);
+   } else {
+      item = push_size(&p->arena, p->item_size, 8);
+   }
+   p->live_count++;
+
+   pool_unlock(p);
+
+   return item;
+}
+
+void
+pool_free(Pool *p, void *item)
+{
+   if (!item) {
+      return;
+   }
+
+   pool_lock(p);
+
+   p->free = pool_item_free(p, item, p->free);
+   p->free_count++;
+   p->live_count--;
+
+   pool_unlock(p);
+}
+
+PoolCache
+pool_cache(Pool *p)
+{
+   PoolCache c = {};
+   c.pool = p;
+
+   return c;
+}
+
+void *
+pool_cache_alloc(PoolCache *c)
+{
+   Pool *p = c->pool;
+
+   if (!c->free) {
+      pool_lock(p);
+
+      // a batch off the free list, the rest fresh from the arena
+      U32 taken = 0;
+      while (p->free && taken < POOL_CACHE_BATCH) {
+         PoolItem *item = p->free;
+         p->free = pool_item_next(item);
+         c->free = pool_item_free(p, pool_item_alloc(p, item), c->free);
+         taken++;
+      }
+      p->free_count -= taken;
+
+      for (; taken < POOL_CACHE_BATCH; ++taken) {
+         c->free = pool_item_free(p, push_size(&p->arena, p->item_size, 8), c->free);
+      }
+
+      p->live_count += POOL_CACHE_BATCH;
+      pool_unlock(p);
+
+      c->count = POOL_CACHE_BATCH;
+   }
+
+   PoolItem *item = c->free;
+   c->free = pool_item_next(item);
+   c->count--;
+
+   return pool_item_alloc(p, item);
+}
+
+void
+pool_cache_free(PoolCache *c, void *item)
+{
+   if (!item) {
+      return;
+   }
+
+   Pool *p = c->pool;
+   c->free = pool_item_free(p, item, c->free);
+   c->count++;
+
+   if (c->count < 2 * POOL_CACHE_BATCH) {
+      return;
+   }
+
+   // keeps a batch for the next allocations, the rest goes back in one go
+   PoolItem *last = c->free;
+   for (U32 i = 1; i < POOL_CACHE_BATCH; ++i) {
+      last = pool_item_next(last);
+   }
+
+   ASAN_UNPOISON_MEMORY_REGION(last, sizeof(PoolItem));
+   PoolItem *rest = last->next;
+   last->next = 0;
+   ASAN_POISON_MEMORY_REGION(last, sizeof(PoolItem));
+
+   PoolItem *rest_last = rest;
+   for (U32 i = 1; i < c->count - POOL_CACHE_BATCH; ++i) {
+      rest_last = pool_item_next(rest_last);
+   }
+
+   U32 returned = c->count - POOL_CACHE_BATCH;
+   c->count = POOL_CACHE_BATCH;
+
+   pool_lock(p);
+
+   ASAN_UNPOISON_MEMORY_REGION(rest_last, sizeof(PoolItem));
+   rest_last->next = p->free;
+   ASAN_POISON_MEMORY_REGION(rest_last, sizeof(PoolItem));
+
+   p->free = rest;
+   p->free_count += returned;
+   p->live_count -= returned;
+
+   pool_unlock(p);
+}
+
+void
+pool_cache_flush(PoolCache *c)
+{
+   Pool *p = c->pool;
+   if (!c->free) {
+      return;
+   }
+
+   PoolItem *last = c->free;
+   for (U32 i = 1; i < c->count; ++i) {
+      last = pool_item_next(last);
+   }
+
+   pool_lock(p);
+
+   ASAN_UNPOISON_MEMORY_REGION(last, sizeof(PoolItem));
+   last->next = p->free;
+   ASAN_POISON_MEMORY_REGION(last, sizeof(PoolItem));
+
+   p->free = c->free;
+   p->free_count += c->count;
+   p->live_count -= c->count;
+
+   pool_unlock(p);
+
+   c->free = 0;
+   c->count = 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "base.h"
+#include "base_arena.h"
+#include "base_os.h"
+
+enum
+{
+   POOL_CACHE_BATCH = 32, // items a cache takes from or gives back to its pool at once
+};
+
+// a free item, the link lives in the item itself
+struct PoolItem
+{
+   PoolItem *next;
+};
+
+// Fixed size items pushed onto an arena and recycled through a free list.
+// Free items are poisoned under ASan. A shared pool takes its lock for every
+// call, threads that allocate a lot go through a PoolCache instead.
+struct Pool
+{
+   Arena arena; // new items are pushed here, only by the pool
+   U64 item_size;
+   PoolItem *free;
+   U64 free_count;
+   U64 live_count; // items in caches count as live
+   OS_Handle mutex; // of a shared pool
+};
+
+// Free items of one thread, refilled from and flushed to the pool in batches
+struct PoolCache
+{
+   Pool *pool;
+   PoolItem *free;
+   U32 count;
+};
+
+intern void init_pool(Pool *p, Arena arena, U64 item_size, B32 shared=0);
+// the items stay in the arena, it is released by its owner
+intern void release_pool(Pool *p);
+
+intern void *pool_alloc(Pool *p);
+intern void pool_free(Pool *p, void *item);
+
+intern PoolCache pool_cache(Pool *p);
+intern void *pool_cache_alloc(PoolCache *c);
+intern void pool_cache_free(PoolCache *c, void *item);
+// gives every cached item back to the pool, call before the thread exits
+intern void pool_cache_flush(PoolCache *c);
+
+#define init_pool_of(p, arena, ty, ...) init_pool(p, arena, sizeof(ty), ## __VA_ARGS__)
+#define pool_alloc_struct(p, ty) (ty *) pool_alloc(p)
+#define pool_cache_alloc_struct(c, ty) (ty *) pool_cache_alloc(c)
@@ -1,8 +1,8 @@
 @echo off
 
 set WARNINGS=-Wall -Wextra -Wconversion -Wno-sign-conversion -Wno-unused-but-set-variable -Wno-unused-parameter -Wno-unused-variable -Wno-unused-function -Wno-char-subscripts
-set CFLAGS=%WARNINGS% -std=c++20
-set DEBUG_FLAGS=-DBUILD_DEBUG -g3
+set CFLAGS=%WARNINGS% -std=c++20 -mssse3
+set DEBUG_FLAGS=-DBUILD_DEBUG -DARENA_STATS -g3
 
 set RELEASE_FLAGS=-O2
 
@@ -14,4 +14,5 @@ set LINK_FLAGS=-L./vendor/glfw/libs -L./vendor/glew/libs -L./vendor/freetype/lib
 rem clang -Wno-everything %RELEASE_FLAGS% ./vendor/treesitter/src -I ./vendor/treesitter/include -c -o treesitter.o ./vendor/treesitter/build/build.c
 clang++ %DEBUG_FLAGS% %CFLAGS% %COMPILE_FLAGS% editor/editor.cpp treesitter.o %LINK_FLAGS% -o editor_debug.exe
 rem clang++ %RELEASE_FLAGS% %CFLAGS% %COMPILE_FLAGS% editor/editor.cpp treesitter.o %LINK_FLAGS% -o editor_release.exe
-rem clang++ %RELEASE_FLAGS% %CFLAGS% %COMPILE_FLAGS% tests/tests.cpp %LINK_FLAGS% -o tests.exe
+rem clang++ %RELEASE_FLAGS% %CFLAGS% %COMPILE_FLAGS% tests/tests.cpp treesitter.o %LINK_FLAGS% -o tests.exe
+rem clang++ %RELEASE_FLAGS% %CFLAGS% %COMPILE_FLAGS% tests/benchmarks.cpp treesitter.o %LINK_FLAGS% -o benchmarks.exe
@@ -1,7 +1,7 @@
 @echo off
 
 set CFLAGS=/W3 /wd4100 /wd4189 /std:c++20
-set DEBUG_FLAGS=/DBUILD_DEBUG /Z7
+set DEBUG_FLAGS=/DBUILD_DEBUG /DARENA_STATS /Z7
 
 set PROFILER_FLAGS=
 
@@ -3,10 +3,18 @@
 #include "editor.h"
 
 #include "tree_sitter/api.h"
+#include "parse_worker.h"
 
 enum
 {
-   MAX_GAP_SIZE = 16
+   MIN_GAP_SIZE = 16,
+   MAX_GAP_GROWTH = 1 << 20,
+
+   // files from this size on open in the piece tree and stay mapped
+   MAPPED_FILE_SIZE = 64 << 20,
+
+   // a loading file becomes visible in steps of this many pages
+   LOAD_PUBLISH_PAGES = 64,
 };
 
 extern "C" const TSLanguage *tree_sitter_cpp(void);
@@ -46,6 +54,103 @@ utf8_len(U8 byte)
    return 1;
 }
 
+U8
+buffer_byte_at(TextBuffer *buf, U64 pos)
+{
+   if (pos >= buf->len) {
+      return 0;
+   }
+
+   return (*buf)[pos];
+}
+
+U32
+buffer_codepoint_at(TextBuffer *buf, U64 pos, U32 *len)
+{
+   U8 lead = (*buf)[pos];
+   U32 n = utf8_len(lead);
+
+   if_likely (n == 1) {
+      *len = 1;
+      return lead < 0x80 ? lead : 0xFFFD;
+   }
+
+   U32 codepoint = lead & (0x7F >> n);
+   for (U32 i = 1; i < n; ++i) {
+      if (pos + i >= buf->len || ((*buf)[pos + i] & 0xC0) != 0x80) {
+         // broken sequence, only the lead byte is consumed
+         *len = 1;
+         return 0xFFFD;
+      }
+
+      codepoint = (codepoint << 6) | ((*buf)[pos + i] & 0x3F);
+   }
+
+   *len = n;
+   return codepoint;
+}
+
+intern NKINLINE void
+line_index_push(GapBuffer *buf, U64 newline)
+{
+   LineIndex *li = &buf->lines;
+   ASSERT(li->before + li->after < li->cap);
+
+   li->committed_before = commit_grow((U8 *) li->ptr, li->committed_before, (li->before + 1) * sizeof(U64), li->cap * sizeof(U64));
+   li->ptr[li->before++] = newline;
+}
+
+// keeps the line index split at the same place as the text: newlines in
+// front of pos are stored absolute, the ones behind it relative to the end
+intern void
+line_index_move_gap(GapBuffer *buf, U64 pos)
+{
+   LineIndex *li = &buf->lines;
+
+   while (li->before > 0 && li->ptr[li->before - 1] >= pos) {
+      U64 newline = li->ptr[--li->before];
+      li->after++;
+      li->committed_after = commit_grow_down((U8 *) (li->ptr + li->cap), li->committed_after, li->after * sizeof(U64), li->cap * sizeof(U64));
+      li->ptr[li->cap - li->after] = buf->len - newline;
+   }
+
+   while (li->after > 0) {
+      U64 newline = buf->len - li->ptr[li->cap - li->after];
+      if (newline >= pos) {
+         break;
+      }
+
+      li->after--;
+      li->committed_before = commit_grow((U8 *) li->ptr, li->committed_before, (li->before + 1) * sizeof(U64), li->cap * sizeof(U64));
+      li->ptr[li->before++] = newline;
+   }
+}
+
+// removes size bytes behind the gap
+intern void
+gap_buffer_remove(GapBuffer *buf, U64 size)
+{
+   LineIndex *li = &buf->lines;
+
+   size = MIN(size, buf->len - buf->start);
+
+   U64 removed_end = buf->start + size;
+   while (li->after > 0 && buf->len - li->ptr[li->cap - li->after] < removed_end) {
+      li->after--;
+   }
+
+   buf->end += size;
+   buf->len -= size;
+}
+
+// the bytes from..to of the text are new
+intern NKINLINE void
+gap_buffer_touch(GapBuffer *buf, U64 from, U64 to)
+{
+   buf->untouched_before = MIN(buf->untouched_before, from);
+   buf->untouched_after = MIN(buf->untouched_after, buf->len - to);
+}
+
 intern void
 move_gap(GapBuffer *buf, U64 pos)
 {
@@ -53,6 +158,8 @@ move_gap(GapBuffer *buf, U64 pos)
       return;
    }
 
+   line_index_move_gap(buf, pos);
+
    if (buf->start == buf->end) {
       buf->start = pos;
       buf->end = pos;
@@ -77,65 +184,309 @@ gap_buffer_from_arena(Arena a)
 {
    GapBuffer buf = {};
 
-   buf.ptr = a.ptr;
-   buf.cap = a.size;
+   Arena text = {};
+   sub_arena(&text, &a, ALIGN_POW2(a.size / 4 * 3, sizeof(U64)));
+   arena_set_name(&text, "gap buffer text");
+
+   // the rest holds the line index, one U64 per newline
+   buf.lines.ptr = (U64 *) (a.ptr + a.top);
+   buf.lines.cap = (a.size - a.top) / sizeof(U64);
+
+   buf.ptr = text.ptr;
+   buf.cap = text.size;
    buf.start = 0;
-   buf.end = MAX_GAP_SIZE;
+   buf.end = MIN_GAP_SIZE;
    buf.len = 0;
+   buf.grow = MIN_GAP_SIZE;
+   buf.committed = commit_grow(buf.ptr, 0, buf.end, buf.cap);
 
    return buf;
 }
 
-void
-load_source_file(GapBuffer *buf, String8 path, Arena *a)
+TextBuffer
+text_buffer_from_arena(Arena a, U32 backend)
 {
-   TempArena temp = begin_temp_arena(a);
+   TextBuffer buf = {};
+   buf.backend = backend;
 
-   String8 content = os_read_file(path, temp.arena);
-   if (!content.ptr) {
-      log_error("File '%.*s' does not exist\n", (int)path.len, path.ptr);
-      end_temp_arena(temp);
-      return;
+   if (backend == BUFFER_GAP) {
+      buf.gap = gap_buffer_from_arena(a);
+   } else {
+      buf.tree = piece_tree_from_arena(a);
    }
 
-   // remove carriage returns
-   U8 *src = content.ptr;
-   U8 *src_end = content.ptr + content.len;
-   U8 *dst = buf->ptr;
-   while (src < src_end) {
-      if (*src != '\r') {
-         *dst = *src;
-         dst++;
-         buf->start++;
-         buf->len++;
+   return buf;
+}
+
+intern void
+buffer_load_worker(void *param)
+{
+   BufferLoad *load = (BufferLoad *) param;
+   String8 file = load->file;
+
+   U64 text_pos = 0;
+   U64 line_pos = 0;
+
+   // commits what it writes, the buffer commits the same range again once
+   // it takes the pages over
+   U64 text_committed = 0;
+   U64 lines_committed = 0;
+
+   for (U64 i = 0; i < load->page_count; ++i) {
+      if (i % LOAD_PUBLISH_PAGES == 0) {
+         atomic_store_u64(&load->pages_done, i);
+
+         if (atomic_load_u32(&load->cancel)) {
+            return;
+         }
+      }
+
+      U8 *page = file.ptr + i * PIECE_MAX_LEN;
+      U64 page_len = MIN(file.len - i * PIECE_MAX_LEN, (U64)PIECE_MAX_LEN);
+
+      LoadPage *lp = &load->pages[i];
+
+      if (load->backend == BUFFER_GAP) {
+         text_committed = commit_grow(load->text, text_committed, text_pos + page_len, load->text_cap);
+
+         U8 *dst = load->text + text_pos;
+         U64 len = strip_cr(dst, page, page_len);
+
+         U64 lf = 0;
+         for (U64 j = find_newline(dst, len); j < len; j += 1 + find_newline(dst + j + 1, len - j - 1)) {
+            ASSERT(line_pos < load->lines_cap);
+            lines_committed = commit_grow((U8 *) load->lines, lines_committed, (line_pos + 1) * sizeof(U64), load->lines_cap * sizeof(U64));
+            load->lines[line_pos++] = text_pos + j;
+            lf++;
+         }
+
+         lp->ptr = dst;
+         lp->len = (U32)len;
+         lp->lf = (U32)lf;
+         text_pos += len;
+      } else {
+         // pages without a carriage return are referenced in place and only
+         // read when displayed, the others are copied into the add buffer
+         if (memchr(page, '\r', page_len)) {
+            text_committed = commit_grow(load->text, text_committed, text_pos + page_len, load->text_cap);
+
+            U8 *dst = load->text + text_pos;
+            U64 len = strip_cr(dst, page, page_len);
+
+            lp->ptr = dst;
+            lp->len = (U32)len;
+            text_pos += len;
+         } else {
+            lp->ptr = page;
+            lp->len = (U32)page_len;
+         }
+
+         lp->lf = (U32)count_newlines(lp->ptr, lp->len);
       }
-      src++;
    }
 
-   buf->ptr[buf->len] = 0;
+   atomic_store_u64(&load->pages_done, load->page_count);
+}
+
+BufferLoad *
+buffer_load_begin(TextBuffer *buf, String8 file, B32 threaded)
+{
+   ASSERT(buf->len == 0);
+
+   U64 page_count = (file.len + PIECE_MAX_LEN - 1) / PIECE_MAX_LEN;
+
+   Arena arena = {};
+   init_arena(&arena, sizeof(BufferLoad) + page_count * sizeof(LoadPage) + 64);
+   arena_set_name(&arena, "buffer load");
+
+   BufferLoad *load = push_struct(&arena, BufferLoad, 8);
+   *load = {};
+   load->pages = push_array(&arena, LoadPage, page_count);
+   load->arena = arena;
+   load->file = file;
+   load->backend = buf->backend;
+   load->page_count = page_count;
+
+   if (buf->backend == BUFFER_GAP) {
+      GapBuffer *gb = &buf->gap;
+      ASSERT(file.len + MIN_GAP_SIZE <= gb->cap);
+
+      load->text = gb->ptr;
+      load->text_cap = gb->cap;
+      load->lines = gb->lines.ptr;
+      load->lines_cap = gb->lines.cap;
+   } else {
+      PieceTree *pt = &buf->tree;
+      ASSERT(pt->add_len + file.len <= pt->add_cap);
+
+      load->text = pt->add + pt->add_len;
+      load->text_cap = pt->add_cap - pt->add_len;
+      pt->file = file;
+   }
+
+   buf->loading = 1;
+
+   if (threaded) {
+      load->thread = os_thread_start(buffer_load_worker, load);
+   }
+
+   if (!load->thread) {
+      buffer_load_worker(load);
+   }
+
+   return load;
+}
+
+B32
+buffer_load_poll(BufferLoad *load, TextBuffer *buf)
+{
+   U64 done = atomic_load_u64(&load->pages_done);
+
+   for (; load->pages_taken < done; ++load->pages_taken) {
+      LoadPage lp = load->pages[load->pages_taken];
+
+      if (buf->backend == BUFFER_GAP) {
+         buf->gap.len += lp.len;
+         buf->gap.lines.before += lp.lf;
+      } else {
+         PieceTree *pt = &buf->tree;
+         piece_tree_append(pt, lp.ptr, lp.len, lp.lf);
+
+         if (lp.ptr != load->file.ptr + load->pages_taken * PIECE_MAX_LEN) {
+            pt->add_len = (U64)(lp.ptr + lp.len - pt->add);
+         }
+      }
+   }
+
+   if (buf->backend == BUFFER_GAP) {
+      GapBuffer *gb = &buf->gap;
+      gb->start = gb->len;
+      gb->end = gb->start + MIN_GAP_SIZE;
+      gb->untouched_before = 0;
+      gb->untouched_after = 0;
+      gb->committed = commit_grow(gb->ptr, gb->committed, gb->end, gb->cap);
+
+      LineIndex *li = &gb->lines;
+      li->committed_before = commit_grow((U8 *) li->ptr, li->committed_before, li->before * sizeof(U64), li->cap * sizeof(U64));
+
+      buf->len = gb->len;
+   } else {
+      PieceTree *pt = &buf->tree;
+      pt->add_committed = commit_grow(pt->add, pt->add_committed, pt->add_len, pt->add_cap);
+
+      buf->len = pt->len;
+   }
+
+   if (done < load->page_count) {
+      return 0;
+   }
+
+   if (load->thread) {
+      os_thread_join(load->thread);
+   }
+
+   if (buf->backend == BUFFER_GAP) {
+      buf->gap.ptr[buf->gap.len] = 0;
+      os_unmap_file(load->file);
+   }
+
+   // CRLF if most newlines had a carriage return in front
+   U64 carriage_returns = load->file.len - buf->len;
+   U64 newlines = buffer_line_count(buf) - 1;
+   buf->line_ending = carriage_returns * 2 > newlines ? LINE_ENDING_CRLF : LINE_ENDING_LF;
+   buf->loading = 0;
+
+   Arena arena = load->arena;
+   free_arena(&arena, arena.size);
+
+   return 1;
+}
+
+void
+buffer_load_cancel(BufferLoad *load, TextBuffer *buf)
+{
+   atomic_store_u32(&load->cancel, 1);
+
+   if (load->thread) {
+      os_thread_join(load->thread);
+   }
+
+   // the piece tree references the mapping until the buffer is released
+   if (buf->backend == BUFFER_GAP) {
+      os_unmap_file(load->file);
+   }
+
+   buf->loading = 0;
+
+   Arena arena = load->arena;
+   free_arena(&arena, arena.size);
+}
+
+U32
+buffer_load_percent(BufferLoad *load)
+{
+   if (load->page_count == 0) {
+      return 100;
+   }
+
+   return (U32)(load->pages_taken * 100 / load->page_count);
+}
 
-   buf->end = buf->start + MAX_GAP_SIZE;
+void
+load_source_file(TextBuffer *buf, String8 file)
+{
+   BufferLoad *load = buffer_load_begin(buf, file, 0);
+   B32 done = buffer_load_poll(load, buf);
+   ASSERT(done);
+}
 
-   end_temp_arena(temp);
+void
+text_buffer_release(TextBuffer *buf)
+{
+   if (buf->backend == BUFFER_PIECE_TREE) {
+      piece_tree_release(&buf->tree);
+   }
 }
 
-U64 insert_char(GapBuffer *buf, U8 c, U64 pos)
+void
+gap_buffer_reserve(GapBuffer *buf, U64 n)
 {
-   ASSERT(buf->len < buf->cap - MAX_GAP_SIZE);
+   U64 gap_size = buf->end - buf->start;
+   if (gap_size >= n) {
+      return;
+   }
+
+   // grow by at least the requested amount and double the step on every
+   // refill, so repeated inserts at one site move the tail O(log n) times
+   U64 grow = MAX(n - gap_size, buf->grow);
+   grow = MIN(grow, buf->cap - buf->len - gap_size);
+   ASSERT(gap_size + grow >= n);
 
+   buf->committed = commit_grow(buf->ptr, buf->committed, buf->len + gap_size + grow, buf->cap);
+
+   MEM_MOVE(buf->ptr + buf->end + grow, buf->ptr + buf->end, buf->len - buf->start);
+   buf->end += grow;
+
+   buf->grow = MIN(buf->grow * 2, (U64)MAX_GAP_GROWTH);
+}
+
+U64
+insert_char(GapBuffer *buf, U8 c, U64 pos)
+{
    if (pos > buf->len) {
       return pos;
    }
 
    move_gap(buf, pos);
+   gap_buffer_reserve(buf, 1);
 
-   if (buf->start == buf->end) {
-      U64 shift = MAX_GAP_SIZE;
-      MEM_MOVE(buf->ptr + buf->end + shift, buf->ptr + buf->end, buf->len - buf->end);
-      buf->end += shift;
+   if (c == '\n') {
+      line_index_push(buf, buf->start);
    }
+
    buf->ptr[buf->start++] = c;
    buf->len++;
+   gap_buffer_touch(buf, pos, pos + 1);
 
    return pos + 1;
 }
@@ -143,38 +494,27 @@ U64 insert_char(GapBuffer *buf, U8 c, U64 pos)
 U64
 insert_string(GapBuffer *buf, String8 s, U64 pos)
 {
-   ASSERT(buf->len + s.len < buf->cap - MAX_GAP_SIZE);
-
    if (pos > buf->len) {
       return pos;
    }
 
    move_gap(buf, pos);
+   gap_buffer_reserve(buf, s.len);
 
-   while (s.len > 0) {
-      U64 gap_size = buf->end - buf->start;
-      if (gap_size == 0) {
-         U64 shift = MAX_GAP_SIZE;
-         MEM_MOVE(buf->ptr + buf->end + shift, buf->ptr + buf->end, buf->len - buf->end);
-         buf->end += shift;
-         gap_size = shift;
-      }
-
-      U64 copy_len = MIN(s.len, gap_size);
-      MEM_COPY(buf->ptr + buf->start, s.ptr, copy_len);
-
-      s.ptr += copy_len;
-      s.len -= copy_len;
-
-      buf->start += copy_len;
-      buf->len += copy_len;
+   for (U64 i = find_newline(s.ptr, s.len); i < s.len; i += 1 + find_newline(s.ptr + i + 1, s.len - i - 1)) {
+      line_index_push(buf, buf->start + i);
    }
 
+   MEM_COPY(buf->ptr + buf->start, s.ptr, s.len);
+   buf->start += s.len;
+   buf->len += s.len;
+   gap_buffer_touch(buf, pos, pos + s.len);
+
    return pos + s.len;
 }
 
 U64
-insert_line(GapBuffer *buf, U64 pos, B32 auto_indent)
+insert_line(TextBuffer *buf, U64 pos, B32 auto_indent)
 {
    if (pos > buf->len) {
       return pos;
@@ -184,11 +524,11 @@ insert_line(GapBuffer *buf, U64 pos, B32 auto_indent)
       U64 indent = line_indent(buf, pos);
 
       U64 lcc = cursor_back(buf, pos);
-      while (lcc > 0 && is_whitespace((*buf)[lcc])) {
+      while (lcc > 0 && is_whitespace(buffer_byte_at(buf, lcc))) {
          lcc = cursor_back(buf, lcc);
       }
 
-      U8 last_char = (*buf)[lcc];
+      U8 last_char = buffer_byte_at(buf, lcc);
 
       if (last_char == '{') {
          indent += TAB_SIZE;
@@ -220,9 +560,8 @@ delete_char(GapBuffer *buf, U64 pos)
    
    move_gap(buf, pos);
 
-   U32 cl = utf8_len(buf->ptr[buf->end]);
-   buf->end += cl;
-   buf->len -= cl;
+   gap_buffer_remove(buf, utf8_len(buf->ptr[buf->end]));
+   gap_buffer_touch(buf, pos, pos);
 
    return pos;
 }
@@ -243,13 +582,15 @@ delete_chars(GapBuffer *buf, U64 pos, U64 n)
 
    move_gap(buf, pos);
 
-   while (n > 0 && buf->end < buf->cap) {
-      U32 cl = utf8_len(buf->ptr[buf->end]);
-      buf->end += cl;
-      buf->len -= cl;
+   U64 size = 0;
+   while (n > 0 && buf->start + size < buf->len) {
+      size += utf8_len(buf->ptr[buf->end + size]);
       n--;
    }
 
+   gap_buffer_remove(buf, size);
+   gap_buffer_touch(buf, pos, pos);
+
    return pos;
 }
 
@@ -273,43 +614,359 @@ str8_from_gap_buffer(GapBuffer *buf, Arena *a)
    return s;
 }
 
+String8
+gap_buffer_chunk_at(GapBuffer *buf, U64 pos)
+{
+   if (pos < buf->start) {
+      return String8(buf->ptr + pos, buf->start - pos);
+   }
+
+   if (pos < buf->len) {
+      return String8(buf->ptr + buf->end + (pos - buf->start), buf->len - pos);
+   }
+
+   return null_str8;
+}
+
+String8
+gap_buffer_chunk_before(GapBuffer *buf, U64 pos)
+{
+   if (pos <= buf->start) {
+      return String8(buf->ptr, pos);
+   }
+
+   pos = MIN(pos, buf->len);
+   return String8(buf->ptr + buf->end, pos - buf->start);
+}
+
+void
+gap_buffer_take_edited(GapBuffer *buf, U64 *untouched_before, U64 *untouched_after)
+{
+   *untouched_before = buf->untouched_before;
+   *untouched_after = buf->untouched_after;
+
+   buf->untouched_before = buf->len;
+   buf->untouched_after = buf->len;
+}
+
+U64
+gap_buffer_newline_count(GapBuffer *buf)
+{
+   return buf->lines.before + buf->lines.after;
+}
+
+U64
+gap_buffer_newline_offset(GapBuffer *buf, U64 k)
+{
+   LineIndex *li = &buf->lines;
+   ASSERT(k < li->before + li->after);
+
+   if (k < li->before) {
+      return li->ptr[k];
+   }
+
+   return buf->len - li->ptr[li->cap - li->after + (k - li->before)];
+}
+
+U64
+gap_buffer_newlines_before(GapBuffer *buf, U64 pos)
+{
+   U64 lo = 0;
+   U64 hi = gap_buffer_newline_count(buf);
+
+   while (lo < hi) {
+      U64 mid = lo + (hi - lo) / 2;
+
+      if (gap_buffer_newline_offset(buf, mid) < pos) {
+         lo = mid + 1;
+      } else {
+         hi = mid;
+      }
+   }
+
+   return lo;
+}
+
+void
+buffer_reserve(TextBuffer *buf, U64 n)
+{
+   // the piece tree appends into a preallocated add buffer
+   if (buf->backend == BUFFER_GAP) {
+      gap_buffer_reserve(&buf->gap, n);
+   }
+}
+
+U64
+insert_char(TextBuffer *buf, U8 c, U64 pos)
+{
+   if (buf->loading) {
+      return pos;
+   }
+
+   if (buf->backend == BUFFER_GAP) {
+      pos = insert_char(&buf->gap, c, pos);
+      buf->len = buf->gap.len;
+   } else {
+      pos = insert_char(&buf->tree, c, pos);
+      buf->len = buf->tree.len;
+   }
+
+   return pos;
+}
+
+U64
+insert_string(TextBuffer *buf, String8 s, U64 pos)
+{
+   if (buf->loading) {
+      return pos;
+   }
+
+   if (buf->backend == BUFFER_GAP) {
+      pos = insert_string(&buf->gap, s, pos);
+      buf->len = buf->gap.len;
+   } else {
+      pos = insert_string(&buf->tree, s, pos);
+      buf->len = buf->tree.len;
+   }
+
+   return pos;
+}
+
 U64
-line_length(GapBuffer *buf, U64 crs)
+delete_char(TextBuffer *buf, U64 pos)
+{
+   if (buf->loading) {
+      return pos;
+   }
+
+   if (buf->backend == BUFFER_GAP) {
+      pos = delete_char(&buf->gap, pos);
+      buf->len = buf->gap.len;
+   } else {
+      pos = delete_char(&buf->tree, pos);
+      buf->len = buf->tree.len;
+   }
+
+   return pos;
+}
+
+U64
+delete_chars(TextBuffer *buf, U64 pos, U64 n)
+{
+   if (buf->loading) {
+      return pos;
+   }
+
+   if (buf->backend == BUFFER_GAP) {
+      pos = delete_chars(&buf->gap, pos, n);
+      buf->len = buf->gap.len;
+   } else {
+      pos = delete_chars(&buf->tree, pos, n);
+      buf->len = buf->tree.len;
+   }
+
+   return pos;
+}
+
+String8
+str8_from_buffer(TextBuffer *buf, Arena *a)
+{
+   if (buf->backend == BUFFER_GAP) {
+      return str8_from_gap_buffer(&buf->gap, a);
+   } else {
+      return str8_from_piece_tree(&buf->tree, a);
+   }
+}
+
+String8
+buffer_chunk_at(TextBuffer *buf, U64 pos)
+{
+   if (buf->backend == BUFFER_GAP) {
+      return gap_buffer_chunk_at(&buf->gap, pos);
+   } else {
+      return piece_tree_chunk_at(&buf->tree, pos);
+   }
+}
+
+String8
+buffer_chunk_before(TextBuffer *buf, U64 pos)
+{
+   if (buf->backend == BUFFER_GAP) {
+      return gap_buffer_chunk_before(&buf->gap, pos);
+   } else {
+      return piece_tree_chunk_before(&buf->tree, pos);
+   }
+}
+
+U64
+buffer_find_newline(TextBuffer *buf, U64 pos)
+{
+   while (pos < buf->len) {
+      String8 chunk = buffer_chunk_at(buf, pos);
+
+      U64 i = find_newline(chunk.ptr, chunk.len);
+      if (i < chunk.len) {
+         return pos + i;
+      }
+
+      pos += chunk.len;
+   }
+
+   return buf->len;
+}
+
+U64
+buffer_find_newline_reverse(TextBuffer *buf, U64 pos)
+{
+   pos = MIN(pos, buf->len);
+
+   while (pos > 0) {
+      String8 chunk = buffer_chunk_before(buf, pos);
+
+      U64 i = find_newline_reverse(chunk.ptr, chunk.len);
+      if (i < chunk.len) {
+         return pos - chunk.len + i;
+      }
+
+      pos -= chunk.len;
+   }
+
+   return buf->len;
+}
+
+U64
+buffer_find_double_newline(TextBuffer *buf, U64 pos)
+{
+   while (pos < buf->len) {
+      String8 chunk = buffer_chunk_at(buf, pos);
+
+      U64 i = find_double_newline(chunk.ptr, chunk.len);
+      if (i < chunk.len) {
+         return pos + i;
+      }
+
+      pos += chunk.len;
+
+      // a pair split by the chunk boundary
+      if (pos < buf->len && chunk.ptr[chunk.len - 1] == '\n' && (*buf)[pos] == '\n') {
+         return pos - 1;
+      }
+   }
+
+   return buf->len;
+}
+
+U64
+buffer_line_count(TextBuffer *buf)
+{
+   if (buf->backend == BUFFER_GAP) {
+      return gap_buffer_newline_count(&buf->gap) + 1;
+   } else {
+      return piece_tree_newline_count(&buf->tree) + 1;
+   }
+}
+
+U64
+buffer_line_begin(TextBuffer *buf, U64 line)
+{
+   if (line == 0) {
+      return 0;
+   }
+
+   if (line >= buffer_line_count(buf)) {
+      return buf->len;
+   }
+
+   if (buf->backend == BUFFER_GAP) {
+      return gap_buffer_newline_offset(&buf->gap, line - 1) + 1;
+   } else {
+      return piece_tree_newline_offset(&buf->tree, line - 1) + 1;
+   }
+}
+
+TextPoint
+buffer_point(TextBuffer *buf, U64 pos)
+{
+   TextPoint p = {};
+
+   pos = MIN(pos, buf->len);
+
+   if (buf->backend == BUFFER_GAP) {
+      p.row = gap_buffer_newlines_before(&buf->gap, pos);
+   } else {
+      p.row = piece_tree_newlines_before(&buf->tree, pos);
+   }
+
+   p.col = pos - buffer_line_begin(buf, p.row);
+
+   return p;
+}
+
+U64
+line_length(TextBuffer *buf, U64 crs)
 {
    return cursor_line_end(buf, crs) - cursor_line_begin(buf, crs);
 }
 
 Pane
-create_pane(U64 cap, U32 cols, U32 rows)
+create_pane(U64 cap, U32 cols, U32 rows, U32 backend)
 {
    Pane p = {};
    p.rows = rows;
    p.cols = cols;
    
    init_arena(&p.arena, cap);
+   arena_set_name(&p.arena, "pane");
 
-   p.buffer = gap_buffer_from_arena(p.arena);
+   p.buffer = text_buffer_from_arena(p.arena, backend);
    p.highlighter = create_syntax_highlighter();
 
+   pane_damage_all(&p);
+
    return p;
 }
 
 void
 destroy_pane(Pane p)
 {
+   if (p.load) {
+      buffer_load_cancel(p.load, &p.buffer);
+   }
+
+   // the parse worker may still read the pages of the buffer
    destroy_syntax_highlighter(p.highlighter);
+   text_buffer_release(&p.buffer);
    free_arena(&p.arena, p.arena.size);
 }
 
+void
+pane_damage_rows(Pane *p, U64 from_row, U64 to_row)
+{
+   if (from_row >= to_row) {
+      return;
+   }
+
+   if (p->damage_from >= p->damage_to) {
+      p->damage_from = from_row;
+      p->damage_to = to_row;
+   } else {
+      p->damage_from = MIN(p->damage_from, from_row);
+      p->damage_to = MAX(p->damage_to, to_row);
+   }
+}
+
+void
+pane_damage_all(Pane *p)
+{
+   pane_damage_rows(p, 0, max_U64);
+}
+
 SyntaxHighlighter
 create_syntax_highlighter()
 {
    SyntaxHighlighter hl = {};
 
-   hl.parser = ts_parser_new();
-
    const TSLanguage *lang = tree_sitter_cpp();
-   ts_parser_set_language(hl.parser, lang);
 
    const char *query_string =
       "(comment) @comment "
@@ -323,31 +980,213 @@ create_syntax_highlighter()
       log_fatal("failed to create highlighting query");
    }
 
+   hl.cursor = ts_query_cursor_new();
+
+   init_arena(&hl.cache.arena, sizeof(HighlightRow) * HIGHLIGHT_MAX_ROWS);
+   arena_set_name(&hl.cache.arena, "highlight cache");
+   hl.cache.rows = push_array(&hl.cache.arena, HighlightRow, HIGHLIGHT_MAX_ROWS);
+
+   hl.worker = parse_worker_start(lang);
+
    return hl;
 }
 
 void
 destroy_syntax_highlighter(SyntaxHighlighter hl)
 {
+   parse_worker_stop(hl.worker);
+
+   free_arena(&hl.cache.arena, hl.cache.arena.size);
+   ts_query_cursor_delete(hl.cursor);
    ts_query_delete(hl.query);
    ts_tree_delete(hl.tree);
-   ts_parser_delete(hl.parser);
 }
 
 void
-update_syntax_highlighting(Pane *p, Arena *a)
+poll_syntax_highlighting(Pane *p)
 {
    SyntaxHighlighter *hl = &p->highlighter;
 
-   String8 src = str8_from_gap_buffer(&p->buffer, a);
+   if (hl->dirty) {
+      parse_worker_submit(hl->worker, &p->buffer);
+      hl->dirty = 0;
+   }
+
+   TSTree *tree = parse_worker_take(hl->worker);
+   if (tree) {
+      // both trees carry the same edits, so only the rows whose syntax
+      // differs need a new query
+      if (hl->tree) {
+         U32 range_count = 0;
+         TSRange *ranges = ts_tree_get_changed_ranges(hl->tree, tree, &range_count);
+
+         for (U32 i = 0; i < range_count; ++i) {
+            highlight_cache_invalidate(&hl->cache, ranges[i].start_point.row, U64(ranges[i].end_point.row) + 1);
+         }
 
-   if (hl->tree) {
-      TSTree *new_tree = ts_parser_parse_string(hl->parser, hl->tree, (const char *) src.ptr, (U32) src.len);
+         free(ranges);
+      } else {
+         highlight_cache_invalidate(&hl->cache, 0, max_U64);
+      }
 
       ts_tree_delete(hl->tree);
-      hl->tree = new_tree;
+      hl->tree = tree;
+   }
+}
+
+void
+highlight_cache_invalidate(HighlightCache *c, U64 from_row, U64 to_row)
+{
+   U64 view_end = c->first_row + c->row_count;
+
+   from_row = MAX(from_row, c->first_row);
+   to_row = MIN(to_row, view_end);
+
+   for (U64 row = from_row; row < to_row; ++row) {
+      c->rows[row - c->first_row].valid = 0;
+   }
+}
+
+void
+highlight_cache_scroll(HighlightCache *c, U64 first_row, U32 row_count)
+{
+   row_count = MIN(row_count, (U32)HIGHLIGHT_MAX_ROWS);
+
+   if (first_row == c->first_row && row_count == c->row_count) {
+      return;
+   }
+
+   // keep the rows that stay on screen
+   U64 old_first = c->first_row;
+   U64 old_end = old_first + c->row_count;
+   U64 keep_first = MAX(first_row, old_first);
+   U64 keep_end = MIN(first_row + row_count, old_end);
+
+   if (keep_first < keep_end) {
+      MEM_MOVE(c->rows + (keep_first - first_row),
+               c->rows + (keep_first - old_first),
+               (keep_end - keep_first) * sizeof(HighlightRow));
    } else {
-      hl->tree = ts_parser_parse_string(hl->parser, 0, (const char *) src.ptr, (U32) src.len);
+      keep_first = keep_end = first_row;
+   }
+
+   for (U64 row = first_row; row < first_row + row_count; ++row) {
+      if (row < keep_first || row >= keep_end) {
+         c->rows[row - first_row].valid = 0;
+      }
+   }
+
+   c->first_row = first_row;
+   c->row_count = row_count;
+}
+
+U64
+highlight_cache_edit(HighlightCache *c, U64 row, U64 line_count)
+{
+   // rows below moved, their spans belong to other lines now
+   U64 to_row = line_count == c->line_count ? row + 1 : max_U64;
+   highlight_cache_invalidate(c, row, to_row);
+
+   c->line_count = line_count;
+
+   return to_row;
+}
+
+intern U32
+highlight_color(U32 pattern_index)
+{
+   switch (pattern_index) {
+      case 0: return COLOR_TYPE;
+      case 1: return COLOR_FUNCTION;
+      case 2: return COLOR_KEYWORD;
+      case 3: return COLOR_OPERATOR;
+   }
+
+   return COLOR_BACKGROUND;
+}
+
+// one query for a run of invalid rows, captures are cut into spans per row
+intern void
+highlight_query_rows(Pane *p, U64 from_row, U64 to_row)
+{
+   SyntaxHighlighter *hl = &p->highlighter;
+   HighlightCache *c = &hl->cache;
+
+   for (U64 row = from_row; row < to_row; ++row) {
+      HighlightRow *r = &c->rows[row - c->first_row];
+      r->valid = 1;
+      r->span_count = 0;
+   }
+
+   U64 from = buffer_line_begin(&p->buffer, from_row);
+   U64 to = to_row < buffer_line_count(&p->buffer) ? buffer_line_begin(&p->buffer, to_row) : p->buffer.len;
+
+   ts_query_cursor_set_byte_range(hl->cursor, U32(from), U32(to));
+   ts_query_cursor_exec(hl->cursor, hl->query, ts_tree_root_node(hl->tree));
+
+   TSQueryMatch match;
+   while (ts_query_cursor_next_match(hl->cursor, &match)) {
+      U32 color = highlight_color(match.pattern_index);
+      if (!color) {
+         continue;
+      }
+
+      for (U32 i = 0; i < match.capture_count; i++) {
+         TSNode node = match.captures[i].node;
+         TSPoint start = ts_node_start_point(node);
+         TSPoint end = ts_node_end_point(node);
+
+         U64 first = MAX((U64)start.row, from_row);
+         U64 last = MIN((U64)end.row + 1, to_row);
+
+         for (U64 row = first; row < last; ++row) {
+            HighlightRow *r = &c->rows[row - c->first_row];
+            if (r->span_count == HIGHLIGHT_MAX_SPANS) {
+               continue;
+            }
+
+            HighlightSpan *span = &r->spans[r->span_count++];
+            span->start_col = row == start.row ? start.column : 0;
+            span->end_col = row == end.row ? end.column : max_U32;
+            span->color = color;
+         }
+      }
+   }
+
+   c->rows_queried += to_row - from_row;
+   pane_damage_rows(p, from_row, to_row);
+}
+
+void
+highlight_rows(Pane *p, U64 first_row, U32 row_count)
+{
+   SyntaxHighlighter *hl = &p->highlighter;
+   HighlightCache *c = &hl->cache;
+
+   highlight_cache_scroll(c, first_row, row_count);
+
+   U64 line_count = buffer_line_count(&p->buffer);
+   c->line_count = line_count;
+
+   if (!hl->tree) {
+      return;
+   }
+   U64 end = MIN(c->first_row + c->row_count, line_count);
+
+   U64 row = c->first_row;
+   while (row < end) {
+      if (c->rows[row - c->first_row].valid) {
+         row++;
+         continue;
+      }
+
+      U64 run_end = row + 1;
+      while (run_end < end && !c->rows[run_end - c->first_row].valid) {
+         run_end++;
+      }
+
+      highlight_query_rows(p, row, run_end);
+      row = run_end;
    }
 }
 
@@ -383,38 +1222,23 @@ pane_reset_col_store(Pane *p)
 void
 update_scroll(Pane *pane)
 {
-   U32 cursor_line = 0;
-   U64 cursor_col = 0;
-
-   for (U64 i = 0; i < pane->cursor; ++i) {
-      if (pane->buffer[i] == '\n') {
-         cursor_line++;
-         cursor_col = 0;
-      } else {
-         cursor_col++;
-      }
-   }
+   U64 cursor_line = buffer_point(&pane->buffer, pane->cursor).row;
 
    if (cursor_line < pane->scroll_offset) {
-      pane->scroll_offset = cursor_line;
+      pane->scroll_offset = U32(cursor_line);
    } else if (cursor_line >= pane->scroll_offset + pane->rows) {
-      pane->scroll_offset = cursor_line - pane->rows + 1;
+      pane->scroll_offset = U32(cursor_line - pane->rows + 1);
    }
 
-   U32 total_lines = 1;
-   for (U64 i = 0; i < pane->buffer.len; ++i) {
-      if (pane->buffer[i] == '\n') {
-         total_lines++;
-      }
-   }
+   U64 total_lines = buffer_line_count(&pane->buffer);
 
-   U32 max_scroll = (total_lines > pane->rows) ? (total_lines - pane->rows) : 0;
+   U64 max_scroll = (total_lines > pane->rows) ? (total_lines - pane->rows) : 0;
 
-   pane->scroll_offset = MIN(pane->scroll_offset, max_scroll);
+   pane->scroll_offset = U32(MIN((U64)pane->scroll_offset, max_scroll));
 }
 
 U64
-cursor_back(GapBuffer *buf, U64 crs)
+cursor_back(TextBuffer *buf, U64 crs)
 {
    if (crs > 0) {
       crs--;
@@ -424,7 +1248,7 @@ cursor_back(GapBuffer *buf, U64 crs)
 }
 
 U64
-cursor_next(GapBuffer *buf, U64 crs)
+cursor_next(TextBuffer *buf, U64 crs)
 {
    if (crs < buf->len) {
       crs++;
@@ -434,10 +1258,10 @@ cursor_next(GapBuffer *buf, U64 crs)
 }
 
 U64
-cursor_back_normal(GapBuffer *buf, U64 crs)
+cursor_back_normal(TextBuffer *buf, U64 crs)
 {
    if (crs > 0) {
-      if ((*buf)[crs - 1] != '\n') {
+      if (buffer_byte_at(buf, crs - 1) != '\n') {
          crs--;
       }
    }
@@ -446,10 +1270,10 @@ cursor_back_normal(GapBuffer *buf, U64 crs)
 }
 
 U64
-cursor_next_normal(GapBuffer *buf, U64 crs)
+cursor_next_normal(TextBuffer *buf, U64 crs)
 {
    if (crs < buf->len) {
-      if ((*buf)[crs + 1] != '\n') {
+      if (buffer_byte_at(buf, crs + 1) != '\n') {
          crs++;
       }
    }
@@ -458,118 +1282,103 @@ cursor_next_normal(GapBuffer *buf, U64 crs)
 }
 
 U64
-cursor_line_begin(GapBuffer *buf, U64 crs)
+cursor_line_begin(TextBuffer *buf, U64 crs)
 {
-   crs = cursor_back(buf, crs);
-
-   while (crs > 0) {
-      U8 ch = (*buf)[crs];
-      if (ch == '\n') {
-         return cursor_next(buf, crs);
-      }
-
-      crs = cursor_back(buf, crs);
+   U64 newline = buffer_find_newline_reverse(buf, crs);
+   if (newline == buf->len) {
+      return 0;
    }
 
-   return 0;
+   return newline + 1;
 }
 
 U64
-cursor_line_end(GapBuffer *buf, U64 crs)
+cursor_line_end(TextBuffer *buf, U64 crs)
 {
-   while (crs < buf->len) {
-      U8 ch = (*buf)[crs];
-      if (ch == '\n') {
-         return crs;
-      }
-
-      crs = cursor_next(buf, crs);
-   }
-
-   return buf->len;
+   return buffer_find_newline(buf, crs);
 }
 
 U64
-cursor_next_line_begin(GapBuffer *buf, U64 crs)
+cursor_next_line_begin(TextBuffer *buf, U64 crs)
 {
    return cursor_next(buf, cursor_line_end(buf, crs));
 }
 
 U64
-cursor_prev_line_begin(GapBuffer *buf, U64 crs)
+cursor_prev_line_begin(TextBuffer *buf, U64 crs)
 {
    return cursor_line_begin(buf, cursor_back(buf, cursor_line_begin(buf, crs)));
 }
 
 U64
-cursor_next_line_end(GapBuffer *buf, U64 crs)
+cursor_next_line_end(TextBuffer *buf, U64 crs)
 {
    return cursor_line_end(buf, cursor_next_line_begin(buf, crs));
 }
 
 U64
-cursor_prev_line_end(GapBuffer *buf, U64 crs)
+cursor_prev_line_end(TextBuffer *buf, U64 crs)
 {
    return cursor_back(buf, cursor_line_begin(buf, crs));
 }
 
 U64
-cursor_column(GapBuffer *buf, U64 crs)
+cursor_column(TextBuffer *buf, U64 crs)
 {
    return crs - cursor_line_begin(buf, crs);
 }
 
 intern U64
-cursor_skip_whitespace(U64 crs, GapBuffer *buf)
+cursor_skip_whitespace(U64 crs, TextBuffer *buf)
 {
-   U8 c = (*buf)[crs];
+   U8 c = buffer_byte_at(buf, crs);
 
    crs = cursor_next(buf, crs);
 
-   c = (*buf)[crs];
+   c = buffer_byte_at(buf, crs);
 
    while (is_whitespace(c) && crs < buf->len) {
       crs = cursor_next(buf, crs);
 
-      c = (*buf)[crs];
+      c = buffer_byte_at(buf, crs);
    }
 
    return crs;
 }
 
 intern U64
-cursor_skip_whitespace_reverse(U64 crs, GapBuffer *buf)
+cursor_skip_whitespace_reverse(U64 crs, TextBuffer *buf)
 {
-   U8 c = (*buf)[crs];
+   U8 c = buffer_byte_at(buf, crs);
 
    crs = cursor_back(buf, crs);
 
-   c = (*buf)[crs];
+   c = buffer_byte_at(buf, crs);
 
    while (is_whitespace(c) && crs > 0) {
       crs = cursor_back(buf, crs);
 
-      c = (*buf)[crs];
+      c = buffer_byte_at(buf, crs);
    }
 
    return crs;
 }
 
 U64
-cursor_prev_word(GapBuffer *buf, U64 crs)
+cursor_prev_word(TextBuffer *buf, U64 crs)
 {
-   U8 c = (*buf)[crs];
+   U8 c = buffer_byte_at(buf, crs);
    if (is_whitespace(c)) {
       crs = cursor_skip_whitespace_reverse(crs, buf);
    } else {
       int start_type = char_type(c);
 
       crs = cursor_back(buf, crs);
-      c   = (*buf)[crs];
+      c   = buffer_byte_at(buf, crs);
 
       if (is_whitespace(c)) {
          crs        = cursor_skip_whitespace_reverse(crs, buf);
-         c          = (*buf)[crs];
+         c          = buffer_byte_at(buf, crs);
          start_type = char_type(c);
       }
 
@@ -577,7 +1386,7 @@ cursor_prev_word(GapBuffer *buf, U64 crs)
          while (char_type(c) == start_type && crs > 0) {
             crs = cursor_back(buf, crs);
 
-            c = (*buf)[crs];
+            c = buffer_byte_at(buf, crs);
          }
 
          if (crs != 0) {
@@ -590,9 +1399,9 @@ cursor_prev_word(GapBuffer *buf, U64 crs)
 }
 
 U64
-cursor_end_of_word(GapBuffer *buf, U64 crs)
+cursor_end_of_word(TextBuffer *buf, U64 crs)
 {
-   U8 c = (*buf)[crs];
+   U8 c = buffer_byte_at(buf, crs);
 
    if (is_whitespace(c)) {
       crs = cursor_skip_whitespace(crs, buf);
@@ -601,12 +1410,12 @@ cursor_end_of_word(GapBuffer *buf, U64 crs)
 
       int start_type = char_type(c);
 
-      c = (*buf)[crs];
+      c = buffer_byte_at(buf, crs);
 
       if (is_whitespace(c)) {
          crs = cursor_skip_whitespace(crs, buf);
 
-         c          = (*buf)[crs];
+         c          = buffer_byte_at(buf, crs);
          start_type = char_type(c);
       }
 
@@ -614,7 +1423,7 @@ cursor_end_of_word(GapBuffer *buf, U64 crs)
          while (char_type(c) == start_type && crs < buf->len) {
             crs = cursor_next(buf, crs);
 
-            c = (*buf)[crs];
+            c = buffer_byte_at(buf, crs);
          }
 
          crs = cursor_back(buf, crs);
@@ -625,9 +1434,9 @@ cursor_end_of_word(GapBuffer *buf, U64 crs)
 }
 
 U64
-cursor_next_word(GapBuffer *buf, U64 crs)
+cursor_next_word(TextBuffer *buf, U64 crs)
 {
-   U8 c = (*buf)[crs];
+   U8 c = buffer_byte_at(buf, crs);
 
    if (is_whitespace(c)) {
       crs = cursor_skip_whitespace(crs, buf);
@@ -636,7 +1445,7 @@ cursor_next_word(GapBuffer *buf, U64 crs)
 
       crs = cursor_next(buf, crs);
 
-      c = (*buf)[crs];
+      c = buffer_byte_at(buf, crs);
 
       if (start_type != char_type(c)) {
          return crs;
@@ -649,7 +1458,7 @@ cursor_next_word(GapBuffer *buf, U64 crs)
          crs = cursor_end_of_word(buf, crs);
          crs = cursor_next(buf, crs);
 
-         c = (*buf)[crs];
+         c = buffer_byte_at(buf, crs);
 
          if (is_whitespace(c)) {
             crs = cursor_skip_whitespace(crs, buf);
@@ -661,7 +1470,7 @@ cursor_next_word(GapBuffer *buf, U64 crs)
 }
 
 U64
-cursor_paragraph_up(GapBuffer *buf, U64 crs)
+cursor_paragraph_up(TextBuffer *buf, U64 crs)
 {
    crs = cursor_back(buf, crs);
 
@@ -679,25 +1488,20 @@ cursor_paragraph_up(GapBuffer *buf, U64 crs)
 }
 
 U64
-cursor_paragraph_down(GapBuffer *buf, U64 crs)
+cursor_paragraph_down(TextBuffer *buf, U64 crs)
 {
    crs = cursor_next(buf, crs);
 
-   while (crs < buf->len) {
-      if (crs < buf->len - 1) {
-         if ((*buf)[crs] == '\n' && (*buf)[crs + 1] == '\n') {
-               return crs + 1;
-         }
-      }
-
-      crs = cursor_next(buf, crs);
+   U64 pair = buffer_find_double_newline(buf, crs);
+   if (pair == buf->len) {
+      return buf->len;
    }
 
-   return crs;
+   return pair + 1;
 }
 
 U32
-line_indent(GapBuffer *buf, U64 crs)
+line_indent(TextBuffer *buf, U64 crs)
 {
    U32 result = 0;
 
@@ -717,7 +1521,7 @@ line_indent(GapBuffer *buf, U64 crs)
 }
 
 U32
-brace_matching_indentation(GapBuffer *buf, U64 crs)
+brace_matching_indentation(TextBuffer *buf, U64 crs)
 {
    crs = cursor_back(buf, crs);
    crs = cursor_back(buf, crs);
@@ -1,6 +1,24 @@
 #pragma once
 
 #include "base/base_inc.h"
+#include "math/scan_inc.h"
+#include "piece_tree.h"
+
+// newline offsets of a GapBuffer. Like the text it has a gap at the edit
+// position: entries in front of it are absolute offsets, entries behind it
+// are distances from the end of the text, so edits at the gap touch only the
+// newlines they insert or remove.
+struct LineIndex
+{
+   U64 *ptr;
+   U64 cap;
+   U64 before;
+   U64 after;
+
+   // bytes committed at either end
+   U64 committed_before;
+   U64 committed_after;
+};
 
 struct GapBuffer
 {
@@ -9,6 +27,14 @@ struct GapBuffer
    U64 start; // gap start
    U64 end; // gap end
    U64 len;
+   U64 grow; // next gap refill size
+   U64 committed; // bytes of ptr, covers the text and the gap
+   LineIndex lines;
+
+   // bytes at either end of the text no edit touched since the last
+   // gap_buffer_take_edited
+   U64 untouched_before;
+   U64 untouched_after;
 
    U8 operator[](U64 index) const {
       ASSERT(index < len);
@@ -31,21 +57,152 @@ struct GapBuffer
    }
 };
 
-struct TSParser;
+enum
+{
+   BUFFER_GAP = 0,
+   BUFFER_PIECE_TREE,
+};
+
+enum
+{
+   LINE_ENDING_LF = 0,
+   LINE_ENDING_CRLF,
+};
+
+// the text store of a pane, either backend implements the same edit api
+struct TextBuffer
+{
+   U32 backend;
+   U64 len;
+
+   // carriage returns are stripped on load, this is what the file mostly
+   // used so it can be written back the same way
+   U32 line_ending;
+
+   // edits are ignored while a file is still streaming in
+   B32 loading;
+
+   union {
+      GapBuffer gap;
+      PieceTree tree;
+   };
+
+   U8 operator[](U64 index) const {
+      ASSERT(index < len);
+
+      if_likely (backend == BUFFER_GAP) {
+         return gap[index];
+      } else {
+         return tree[index];
+      }
+   }
+};
+
+// one page of a loading file, already stripped of carriage returns
+struct LoadPage
+{
+   U8 *ptr;
+   U32 len;
+   U32 lf;
+};
+
+// A file streaming into a TextBuffer. The worker only writes memory behind
+// the published pages, buffer_load_poll hands them to the buffer on the ui
+// thread.
+struct BufferLoad
+{
+   Arena arena; // holds this struct and the pages
+   String8 file;
+   U32 backend;
+
+   // where the worker writes: the text and line index of a gap buffer or
+   // the add buffer of a piece tree
+   U8 *text;
+   U64 *lines;
+   U64 lines_cap;
+   U64 text_cap;
+
+   LoadPage *pages;
+   U64 page_count;
+   U64 pages_taken; // ui thread only
+
+   OS_Handle thread;
+   U64 pages_done; // atomic, published by the worker
+   U32 cancel; // atomic, set by the ui thread
+};
+
+struct TextPoint
+{
+   U64 row;
+   U64 col; // in bytes
+};
+
+enum
+{
+   HIGHLIGHT_MAX_ROWS = 512,
+   HIGHLIGHT_MAX_SPANS = 64, // per row, the rest of a very long line stays uncolored
+};
+
+// indices into the palette of the renderer, 0 is the background
+enum
+{
+   COLOR_BACKGROUND = 0,
+   COLOR_FOREGROUND,
+   COLOR_TYPE,
+   COLOR_FUNCTION,
+   COLOR_KEYWORD,
+   COLOR_OPERATOR,
+   COLOR_COUNT,
+};
+
+struct HighlightSpan
+{
+   U32 start_col; // in bytes like TSPoint
+   U32 end_col;
+   U32 color;
+};
+
+struct HighlightRow
+{
+   B32 valid;
+   U32 span_count;
+   HighlightSpan spans[HIGHLIGHT_MAX_SPANS];
+};
+
+// query results of the rows on screen. Rows are only queried again after
+// a new tree changed them, an edit touched them or they scrolled in.
+struct HighlightCache
+{
+   Arena arena;
+   HighlightRow *rows;
+   U64 first_row;
+   U32 row_count;
+   U64 line_count; // of the buffer when the rows were last edited
+
+   U64 rows_queried; // stats
+};
+
 struct TSTree;
 struct TSQuery;
+struct TSQueryCursor;
+struct ParseWorker;
 struct SyntaxHighlighter
 {
-   TSParser *parser;
-   TSTree *tree;
+   TSTree *tree; // what the renderer uses, may lag behind the text
    TSQuery *query;
+   TSQueryCursor *cursor;
+   HighlightCache cache;
+
+   ParseWorker *worker;
+   B32 dirty; // edited since the last snapshot went to the worker
 };
 
 struct Pane
 {
-   GapBuffer buffer;
+   TextBuffer buffer;
    SyntaxHighlighter highlighter;
    Arena arena;
+   BufferLoad *load; // set until the file finished loading
 
    U64 prev_cursor; // for treesitter
    U64 cursor;
@@ -55,30 +212,103 @@ struct Pane
    U32 scroll_offset;
    U32 cols;
    U32 rows;
+
+   // document rows changed since the last frame, the renderer only draws
+   // and uploads these
+   U64 damage_from;
+   U64 damage_to;
 };
 
 intern NKINLINE B32 is_whitespace(U8 c);
 
 intern GapBuffer gap_buffer_from_arena(Arena a);
-intern void load_source_file(GapBuffer *buf, String8 path, Arena *a);
+intern TextBuffer text_buffer_from_arena(Arena a, U32 backend);
+intern void load_source_file(TextBuffer *buf, String8 file);
+intern void text_buffer_release(TextBuffer *buf);
+
+// streams a mapped file into an empty buffer on a worker thread, or right
+// away when threaded is 0. The buffer takes ownership of the mapping.
+intern BufferLoad *buffer_load_begin(TextBuffer *buf, String8 file, B32 threaded);
+// moves what the worker published into buf, returns 1 and frees the load
+// once everything arrived
+intern B32 buffer_load_poll(BufferLoad *load, TextBuffer *buf);
+intern void buffer_load_cancel(BufferLoad *load, TextBuffer *buf);
+intern U32 buffer_load_percent(BufferLoad *load);
+
+// makes the gap at least n bytes large, call before bulk inserts
+intern void gap_buffer_reserve(GapBuffer *buf, U64 n);
 
 intern U64 insert_char(GapBuffer *buf, U8 c, U64 pos);
 intern U64 insert_string(GapBuffer *buf, String8 s, U64 pos);
-intern U64 insert_line(GapBuffer *buf, U64 pos, B32 auto_indent);
 intern U64 delete_char(GapBuffer *buf, U64 pos);
 intern U64 delete_char_back(GapBuffer *buf, U64 pos);
 intern U64 delete_chars(GapBuffer *buf, U64 pos, U64 n);
 
 intern String8 str8_from_gap_buffer(GapBuffer *buf, Arena *a);
 
-intern U64 line_length(GapBuffer *buf, U64 crs);
+// contiguous bytes starting at pos and ending at pos
+intern String8 gap_buffer_chunk_at(GapBuffer *buf, U64 pos);
+intern String8 gap_buffer_chunk_before(GapBuffer *buf, U64 pos);
+
+// the untouched ends since the last call, what lies between them may
+// have changed. Starts over with the whole text untouched.
+intern void gap_buffer_take_edited(GapBuffer *buf, U64 *untouched_before, U64 *untouched_after);
+
+intern U64 gap_buffer_newline_count(GapBuffer *buf);
+intern U64 gap_buffer_newline_offset(GapBuffer *buf, U64 k);
+intern U64 gap_buffer_newlines_before(GapBuffer *buf, U64 pos);
+
+// dispatch to the backend of the buffer
+intern void buffer_reserve(TextBuffer *buf, U64 n);
+intern U64 insert_char(TextBuffer *buf, U8 c, U64 pos);
+intern U64 insert_string(TextBuffer *buf, String8 s, U64 pos);
+intern U64 insert_line(TextBuffer *buf, U64 pos, B32 auto_indent);
+intern U64 delete_char(TextBuffer *buf, U64 pos);
+intern U64 delete_chars(TextBuffer *buf, U64 pos, U64 n);
 
-intern Pane create_pane(U64 cap, U32 cols, U32 rows);
+intern String8 str8_from_buffer(TextBuffer *buf, Arena *a);
+
+// decodes the UTF-8 sequence at pos, broken ones give U+FFFD and len 1
+intern U32 buffer_codepoint_at(TextBuffer *buf, U64 pos, U32 *len);
+
+// 0 at and past the end, so the cursor motions can look one byte ahead
+intern U8 buffer_byte_at(TextBuffer *buf, U64 pos);
+
+intern String8 buffer_chunk_at(TextBuffer *buf, U64 pos);
+intern String8 buffer_chunk_before(TextBuffer *buf, U64 pos);
+
+// vectorized scans over the chunks, they return buf->len when nothing was found
+intern U64 buffer_find_newline(TextBuffer *buf, U64 pos);
+intern U64 buffer_find_newline_reverse(TextBuffer *buf, U64 pos);
+intern U64 buffer_find_double_newline(TextBuffer *buf, U64 pos);
+
+// O(log n) line queries backed by the line index of either backend
+intern U64 buffer_line_count(TextBuffer *buf);
+intern U64 buffer_line_begin(TextBuffer *buf, U64 line);
+intern TextPoint buffer_point(TextBuffer *buf, U64 pos);
+
+intern U64 line_length(TextBuffer *buf, U64 crs);
+
+intern Pane create_pane(U64 cap, U32 cols, U32 rows, U32 backend=BUFFER_GAP);
 intern void destroy_pane(Pane pane);
 
+intern void pane_damage_rows(Pane *p, U64 from_row, U64 to_row);
+intern void pane_damage_all(Pane *p);
+
 intern SyntaxHighlighter create_syntax_highlighter();
 intern void destroy_syntax_highlighter(SyntaxHighlighter hl);
-intern void update_syntax_highlighting(Pane *p, Arena *a);
+// hands the text to the parse worker once per frame and swaps in the
+// newest tree it finished
+intern void poll_syntax_highlighting(Pane *p);
+
+intern void highlight_cache_invalidate(HighlightCache *c, U64 from_row, U64 to_row);
+// moves the cached rows along with the view, rows that scroll in are invalid
+intern void highlight_cache_scroll(HighlightCache *c, U64 first_row, U32 row_count);
+// an edit at row invalidates it, and every row below when the line count
+// changed. Returns the row after the last one invalidated.
+intern U64 highlight_cache_edit(HighlightCache *c, U64 row, U64 line_count);
+// runs the query for the invalid rows of the view and damages them
+intern void highlight_rows(Pane *p, U64 first_row, U32 row_count);
 
 // they not only move the cursor but also reset cursor_store
 intern NKINLINE void pane_cursor_back(Pane *p);
@@ -89,28 +319,28 @@ intern NKINLINE void pane_reset_col_store(Pane *p);
 
 intern void update_scroll(Pane *pane);
 
-intern U64 cursor_back(GapBuffer *buf, U64 crs);
-intern U64 cursor_next(GapBuffer *buf, U64 crs);
+intern U64 cursor_back(TextBuffer *buf, U64 crs);
+intern U64 cursor_next(TextBuffer *buf, U64 crs);
 
 // normal mode back and next. They don't change lines
-intern U64 cursor_back_normal(GapBuffer *buf, U64 crs);
-intern U64 cursor_next_normal(GapBuffer *buf, U64 crs);
+intern U64 cursor_back_normal(TextBuffer *buf, U64 crs);
+intern U64 cursor_next_normal(TextBuffer *buf, U64 crs);
 
-intern U64 cursor_line_begin(GapBuffer *buf, U64 crs);
-intern U64 cursor_line_end(GapBuffer *buf, U64 crs);
-intern U64 cursor_next_line_begin(GapBuffer *buf, U64 crs);
-intern U64 cursor_prev_line_begin(GapBuffer *buf, U64 crs);
-intern U64 cursor_next_line_end(GapBuffer *buf, U64 crs);
-intern U64 cursor_prev_line_end(GapBuffer *buf, U64 crs);
-intern U64 cursor_column(GapBuffer *buf, U64 crs);
+intern U64 cursor_line_begin(TextBuffer *buf, U64 crs);
+intern U64 cursor_line_end(TextBuffer *buf, U64 crs);
+intern U64 cursor_next_line_begin(TextBuffer *buf, U64 crs);
+intern U64 cursor_prev_line_begin(TextBuffer *buf, U64 crs);
+intern U64 cursor_next_line_end(TextBuffer *buf, U64 crs);
+intern U64 cursor_prev_line_end(TextBuffer *buf, U64 crs);
+intern U64 cursor_column(TextBuffer *buf, U64 crs);
 
-intern U64 cursor_prev_word(GapBuffer *buf, U64 crs);
-intern U64 cursor_end_of_word(GapBuffer *buf, U64 crs);
-intern U64 cursor_next_word(GapBuffer *buf, U64 crs);
+intern U64 cursor_prev_word(TextBuffer *buf, U64 crs);
+intern U64 cursor_end_of_word(TextBuffer *buf, U64 crs);
+intern U64 cursor_next_word(TextBuffer *buf, U64 crs);
 
-intern U64 cursor_paragraph_up(GapBuffer *buf, U64 crs);
-intern U64 cursor_paragraph_down(GapBuffer *buf, U64 crs);
+intern U64 cursor_paragraph_up(TextBuffer *buf, U64 crs);
+intern U64 cursor_paragraph_down(TextBuffer *buf, U64 crs);
 
-intern U32 line_indent(GapBuffer *buf, U64 crs);
+intern U32 line_indent(TextBuffer *buf, U64 crs);
 
-intern U32 brace_matching_indentation(GapBuffer *buf, U64 crs);
\ No newline at end of file
+intern U32 brace_matching_indentation(TextBuffer *buf, U64 crs);
\ No newline at end of file
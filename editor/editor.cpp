@@ -4,9 +4,12 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_LCD_FILTER_H
+#include FT_ADVANCES_H
 
 #include "tree_sitter/api.h"
 
+#include <math.h>
+
 #include "base/base_inc.h"
 #include "window.h"
 #include "gfx.h"
@@ -18,19 +21,60 @@
 #include "gfx.cpp"
 #include "glyphmap.cpp"
 #include "buffer.cpp"
+#include "piece_tree.cpp"
+#include "parse_worker.cpp"
 #include "keymaps.cpp"
 
+enum
+{
+   PIPELINE_COMPUTE = 0, // cells into the output texture, then a textured quad
+   PIPELINE_FRAGMENT, // cells straight into the framebuffer
+   PIPELINE_COUNT,
+};
+
+global const char *pipeline_names[PIPELINE_COUNT] = {"compute", "fragment"};
+
 struct Renderer
 {
    GLuint vao;
    GLuint vbo;
    GLuint ebo;
    GFX_Shader shader;
+
+   GFX_Shader cell_shader;
+   GLuint cell_size_loc;
+   GLuint grid_size_loc;
+   GLuint screen_height_loc;
+   GLuint blink_hidden_loc;
+};
+
+enum
+{
+   OUTPUT_RGBA8 = 0,
+   OUTPUT_RGBA16F,
+   OUTPUT_RGBA32F,
+   OUTPUT_FORMAT_COUNT,
+};
+
+struct OutputFormat
+{
+   const char *name; // also the image format qualifier in the shader
+   GLenum internal_format;
+   U32 bytes_per_pixel;
+};
+
+// image stores cannot target sRGB formats, so RGBA8 holds the colors after
+// the gamma correction of the compute shader
+global const OutputFormat output_formats[OUTPUT_FORMAT_COUNT] = {
+   {"rgba8",   GL_RGBA8,   4},
+   {"rgba16f", GL_RGBA16F, 8},
+   {"rgba32f", GL_RGBA32F, 16},
 };
 
 struct OutputTexture
 {
    GLuint id;
+   U32 format;
    U32 width;
    U32 height;
 };
@@ -39,21 +83,97 @@ struct RenderSize
 {
    U32 cols;
    U32 rows;
+   U32 cell_width;
+   U32 cell_height;
 
    GLuint cell_size_loc;
    GLuint grid_size_loc;
+   GLuint pixel_offset_loc;
+   GLuint blink_hidden_loc;
+};
+
+struct CellRect
+{
+   U32 col;
+   U32 row;
+   U32 cols;
+   U32 rows;
+};
+
+enum
+{
+   MAX_DIRTY_RECTS = 4,
+   COMPUTE_TILE_SIZE = 16, // local size of the compute shader
+   GPU_TIMER_QUERIES = 4,
 };
 
-struct RenderRange {
-   U64 from;
-   U64 to;
+// cells whose pixels the compute pass has to shade again, the rest of the
+// output texture is kept from earlier frames
+struct DirtyCells
+{
+   CellRect rects[MAX_DIRTY_RECTS];
+   U32 count;
 };
 
+// GL_TIME_ELAPSED queries in a ring, results are read once the gpu has
+// them so measuring never stalls a frame
+struct GpuTimer
+{
+   GLuint queries[GPU_TIMER_QUERIES];
+   U32 issued;
+   U32 resolved;
+
+   U64 total_ns; // since the stats were last reset
+   U64 samples;
+};
+
+// 8 bytes, colors are indices into the palette
 struct Cell
 {
-   U32 glyph;
-   U32 fg;
-   U32 bg;
+   U16 glyph; // slot in the glyph map
+   U8 fg;
+   U8 bg;
+   U8 flags;
+   U8 pad[3];
+};
+STATIC_ASSERT(sizeof(Cell) == 8);
+
+enum
+{
+   PALETTE_SIZE = 16,
+   PALETTE_BINDING = 4,
+};
+
+// RGB of the COLOR_ indices
+global const U32 palette_colors[COLOR_COUNT] = {
+   0x00000000, // background
+   0x00FFFFFF, // foreground
+   0x00FF0000, // type
+   0x0000FF00, // function
+   0x000000FF, // keyword
+   0x00808080, // operator
+};
+
+// the cells on screen and their copy on the gpu, a frame only renders and
+// uploads the rows that changed
+struct CellGrid
+{
+   Cell *cells;
+   U64 cells_cap; // in bytes, committed as the window grows
+   U64 cells_committed;
+   GLuint ssbo;
+   U32 cols;
+   U32 rows;
+
+   // what the cells show
+   U32 drawn_scroll;
+   U64 drawn_cursor;
+   U64 drawn_cursor_row;
+
+   U64 bytes_uploaded; // by the last frame
+   DirtyCells dirty;
+
+   U64 glyph_evictions; // of the glyph map when the cells were rendered
 };
 
 struct WinEventCtx
@@ -61,11 +181,15 @@ struct WinEventCtx
    RenderSize *render_size;
    OutputTexture *output_texture;
    GFX_Shader compute_shader;
-   GlyphMap *glyph_map;
-   GLuint cells_ssbo;
-   Cell *cells;
+   GlyphMap *glyph_map; // of the current zoom level
+   GlyphAtlasSet *atlases;
+   CellGrid *grid;
    Editor *editor;
    Window *window;
+
+   double last_input_time; // the cursor blink restarts from here
+   B32 redraw; // the window needs a new frame even if no cell changed
+   U32 pipeline; // switched with F12
 };
 
 struct EditPoints {
@@ -80,10 +204,15 @@ enum
    GLYPH_BLINK = 0x2
 };
 
-global const U32 CURSOR_STYLE = (GLYPH_INVERT | GLYPH_BLINK) << 24;
+global const U8 CURSOR_STYLE = GLYPH_INVERT | GLYPH_BLINK;
+
+// seconds the cursor stays visible or hidden
+global const double BLINK_INTERVAL = 0.5;
+// how often a file that is still loading is checked for new pages
+global const double LOAD_POLL_INTERVAL = 1.0 / 60.0;
 
 intern Renderer
-create_renderer(Arena *arena)
+create_renderer()
 {
    static const float vertices[] = {
       // 3d pos + 2d tex coord
@@ -119,12 +248,19 @@ create_renderer(Arena *arena)
 
    glBindVertexArray(0);
 
-   r.shader = load_gfx_shaders(String8("assets/vert_shader.glsl"), String8("assets/frag_shader.glsl"), arena);
+   r.shader = load_gfx_shaders(String8("assets/vert_shader.glsl"), String8("assets/frag_shader.glsl"));
 
    glUseProgram(r.shader.id);
    glUniform1i(glGetUniformLocation(r.shader.id, "tex_text"), 0);
    glUseProgram(0);
 
+   r.cell_shader = load_gfx_shaders(String8("assets/vert_shader.glsl"), String8("assets/cell_frag_shader.glsl"));
+
+   r.cell_size_loc = glGetUniformLocation(r.cell_shader.id, "cell_size");
+   r.grid_size_loc = glGetUniformLocation(r.cell_shader.id, "grid_size");
+   r.screen_height_loc = glGetUniformLocation(r.cell_shader.id, "screen_height");
+   r.blink_hidden_loc = glGetUniformLocation(r.cell_shader.id, "blink_hidden");
+
    return r;
 }
 
@@ -132,6 +268,7 @@ intern void
 destroy_renderer(Renderer r)
 {
    unload_shader(r.shader);
+   unload_shader(r.cell_shader);
 
    glDeleteVertexArrays(1, &r.vao);
    glDeleteBuffers(1, &r.vbo);
@@ -139,136 +276,252 @@ destroy_renderer(Renderer r)
 }
 
 intern void
-apply_syntax_highlighting(Pane *p, Cell *cells, U32 start_row, U32 end_row, RenderRange range)
+apply_syntax_highlighting(Pane *p, Cell *cells, U32 from_row, U32 to_row)
 {
-   SyntaxHighlighter *hl = &p->highlighter;
-
-   if (!hl->tree) {
-      return;
-   }
+   HighlightCache *c = &p->highlighter.cache;
 
-   TSNode root_node = ts_tree_root_node(hl->tree);
-   TSQueryCursor *cursor = ts_query_cursor_new();
+   to_row = MIN(to_row, c->row_count);
 
-   ts_query_cursor_set_byte_range(cursor, U32(range.from), U32(range.to));
-
-   ts_query_cursor_exec(cursor, hl->query, root_node);
+   for (U32 i = from_row; i < to_row; ++i) {
+      HighlightRow *r = &c->rows[i];
+      if (!r->valid) {
+         continue;
+      }
 
-   TSQueryMatch match;
-   while (ts_query_cursor_next_match(cursor, &match)) {
-      for (U32 i = 0; i < match.capture_count; i++) {
-         TSNode node = match.captures[i].node;
-         TSPoint start = ts_node_start_point(node);
-         TSPoint end = ts_node_end_point(node);
-         
-         U32 start_index = (start.row - start_row) * p->cols + start.column;
-         U32 end_index = (end.row - start_row) * p->cols + end.column;
-         
+      Cell *row = cells + i * p->cols;
+      for (U32 s = 0; s < r->span_count; ++s) {
+         HighlightSpan span = r->spans[s];
 
-         U32 color;
-         switch (match.pattern_index) {
-            case 0: color = 0x00FF0000; break; // type
-            case 1: color = 0x0000FF00; break; // function
-            case 2: color = 0x000000FF; break; // keyword
-            case 3: color = 0x00808080; break; // operator
-            default: continue;
-         }
-         
-         for (U32 j = start_index; j < end_index && j < p->cols * (end_row - start_row); j++) {
-            cells[j].fg = color;
+         for (U32 col = span.start_col; col < span.end_col && col < p->cols; ++col) {
+            row[col].fg = U8(span.color);
          }
       }
    }
-   
-   ts_query_cursor_delete(cursor);
 }
 
-intern RenderRange
-render_pane(GlyphMap *gm, Cell *cells, Pane *pane)
+// renders the screen rows [from_row, to_row) into cells that were cleared
+intern void
+render_pane(GlyphMap *gm, Cell *cells, Pane *pane, U32 from_row, U32 to_row)
 {
-   RenderRange range = {};
-
-   const GapBuffer buf = pane->buffer;
+   TextBuffer *buf = &pane->buffer;
 
-   U64 pos = 0;
+   U64 pos = buffer_line_begin(buf, pane->scroll_offset + from_row);
 
-   U32 cell_index = 0;
-   U32 row = 0;
-   U32 col = 0;
-
-   U64 lines_skipped = 0;
-   while (lines_skipped < pane->scroll_offset && pos < buf.len) {
-      if (buf[pos] == '\n') {
-         lines_skipped++;
-      }
-      pos++;
-   }
+   for (U32 row = from_row; row < to_row; ++row) {
+      Cell *line = cells + row * pane->cols;
+      U32 col = 0;
 
-   range.from = pos;
+      for (;;) {
+         if (pos >= buf->len) {
+            // the cursor may sit behind the last character
+            if (pos == pane->cursor && col < pane->cols) {
+               line[col].flags |= GLYPH_INVERT;
+            }
 
-   for (row = 0; row < pane->rows && pos < buf.len; ++row) {
-      col = 0;
+            return;
+         }
 
-      while (col < pane->cols && pos < buf.len) {
-         U8 codepoint = buf[pos];
+         U8 byte = (*buf)[pos];
 
-         if (codepoint == '\n') {
-            if (pos == pane->cursor) {
-               cells[cell_index].bg |= CURSOR_STYLE;
+         if (byte == '\n') {
+            if (pos == pane->cursor && col < pane->cols) {
+               line[col].flags |= CURSOR_STYLE;
             }
 
             pos++;
-            cell_index += pane->cols - col;
             break;
-         } else if (codepoint == '\t') {
+         }
+
+         if (col >= pane->cols) {
+            // lines do not wrap, so screen rows stay document rows
+            pos = buffer_find_newline(buf, pos);
+            continue;
+         }
+
+         if (byte == '\t') {
+            U32 spaces = MIN(TAB_SIZE - (col % TAB_SIZE), pane->cols - col);
+
             if (pos == pane->cursor) {
-               for (U32 i = 0; i < TAB_SIZE; ++i) {
-                  cells[cell_index + i].bg |= CURSOR_STYLE;
+               for (U32 i = 0; i < spaces; ++i) {
+                  line[col + i].flags |= CURSOR_STYLE;
                }
             }
 
-            U32 spaces = TAB_SIZE - (col % TAB_SIZE);
-            cell_index += spaces;
             col += spaces;
             pos++;
          } else {
-            U32 glyph = load_glyph(gm, codepoint);
-            cells[cell_index].glyph = glyph;
-            cells[cell_index].fg = 0x00FFFFFF;
-            cells[cell_index].bg = 0x00000000;
+            U32 len = 1;
+            U32 codepoint = byte < 0x80 ? byte : buffer_codepoint_at(buf, pos, &len);
+
+            Cell *cell = &line[col];
+            cell->glyph = U16(load_glyph(gm, codepoint));
+            cell->fg = COLOR_FOREGROUND;
 
             if (pos == pane->cursor) {
-               cells[cell_index].bg |= CURSOR_STYLE;
+               cell->flags |= CURSOR_STYLE;
             }
 
-            cell_index++;
             col++;
-            pos++;
+            pos += len;
          }
       }
    }
+}
+
+// the cells render_pane marks for the cursor, empty when it is off screen
+intern CellRect
+cursor_cell(Pane *pane)
+{
+   TextBuffer *buf = &pane->buffer;
+   TextPoint p = buffer_point(buf, pane->cursor);
+
+   CellRect r = {};
+   if (p.row < pane->scroll_offset || p.row >= (U64)pane->scroll_offset + pane->rows) {
+      return r;
+   }
+
+   U32 col = 0;
+   for (U64 pos = pane->cursor - p.col; pos < pane->cursor && col < pane->cols;) {
+      U8 byte = (*buf)[pos];
+      col += byte == '\t' ? TAB_SIZE - (col % TAB_SIZE) : 1;
+      pos += utf8_len(byte);
+   }
+
+   if (col >= pane->cols) {
+      return r;
+   }
+
+   B32 on_tab = pane->cursor < buf->len && (*buf)[pane->cursor] == '\t';
+
+   r.col = col;
+   r.row = U32(p.row - pane->scroll_offset);
+   r.cols = on_tab ? MIN(TAB_SIZE - (col % TAB_SIZE), pane->cols - col) : 1;
+   r.rows = 1;
+
+   return r;
+}
 
-   if (pos == pane->cursor && col < pane->cols && row < pane->rows) {
-      cells[cell_index].bg |= GLYPH_INVERT << 24;
+// status in the last row while the rest of the file streams in
+intern void
+render_load_progress(GlyphMap *gm, Cell *cells, Pane *pane)
+{
+   if (pane->rows == 0) {
+      return;
    }
 
-   range.to = pos;
+   char status[64];
+   int len = snprintf(status, sizeof(status), " Loading %u%% ", buffer_load_percent(pane->load));
 
-   return range;
+   Cell *row = cells + (pane->rows - 1) * pane->cols;
+   for (U32 col = 0; col < pane->cols; ++col) {
+      row[col].glyph = col < (U32)len ? U16(load_glyph(gm, (U8)status[col])) : 0;
+      row[col].fg = COLOR_BACKGROUND;
+      row[col].bg = COLOR_FOREGROUND;
+   }
 }
 
 intern void
-render_to_cells(GlyphMap *gm, Cell *cells, RenderSize *rs, Editor *ed)
+add_dirty_cells(DirtyCells *d, CellRect r)
 {
-   U64 cells_size = rs->cols * rs->rows * sizeof(Cell);
-   MEM_SET(cells, 0, cells_size);
+   if (r.cols == 0 || r.rows == 0) {
+      return;
+   }
 
+   if (d->count < MAX_DIRTY_RECTS) {
+      d->rects[d->count++] = r;
+      return;
+   }
+
+   // out of rects, grow the last one to cover both
+   CellRect *last = &d->rects[d->count - 1];
+   U32 col_end = MAX(last->col + last->cols, r.col + r.cols);
+   U32 row_end = MAX(last->row + last->rows, r.row + r.rows);
+
+   last->col = MIN(last->col, r.col);
+   last->row = MIN(last->row, r.row);
+   last->cols = col_end - last->col;
+   last->rows = row_end - last->row;
+}
+
+intern void
+resize_cell_grid(CellGrid *grid, Pane *pane, U32 cols, U32 rows)
+{
+   grid->cols = cols;
+   grid->rows = rows;
+   grid->cells_committed = commit_grow((U8 *)grid->cells, grid->cells_committed, U64(cols) * rows * sizeof(Cell), grid->cells_cap);
+
+   // the storage is only reallocated here, frames update it in place
+   glBindBuffer(GL_SHADER_STORAGE_BUFFER, grid->ssbo);
+   glBufferData(GL_SHADER_STORAGE_BUFFER, U64(cols) * rows * sizeof(Cell), 0, GL_DYNAMIC_DRAW);
+
+   pane_damage_all(pane);
+}
+
+intern void
+render_to_cells(GlyphMap *gm, CellGrid *grid, Editor *ed)
+{
    Pane *pane = &ed->pane;
+   grid->bytes_uploaded = 0;
+
+   if (pane->cols != grid->cols || pane->rows != grid->rows) {
+      return;
+   }
+
+   highlight_rows(pane, pane->scroll_offset, pane->rows);
+
+   // cells that were not rendered again may show a slot that now holds
+   // another glyph
+   if (gm->evictions != grid->glyph_evictions) {
+      grid->glyph_evictions = gm->evictions;
+      pane_damage_all(pane);
+   }
+
+   if (pane->scroll_offset != grid->drawn_scroll) {
+      pane_damage_all(pane);
+   }
+
+   if (pane->cursor != grid->drawn_cursor) {
+      U64 cursor_row = buffer_point(&pane->buffer, pane->cursor).row;
+
+      pane_damage_rows(pane, grid->drawn_cursor_row, grid->drawn_cursor_row + 1);
+      pane_damage_rows(pane, cursor_row, cursor_row + 1);
+
+      grid->drawn_cursor = pane->cursor;
+      grid->drawn_cursor_row = cursor_row;
+   }
+
+   grid->drawn_scroll = pane->scroll_offset;
+
+   U64 first_row = pane->scroll_offset;
+   U64 from = MAX(pane->damage_from, first_row);
+   U64 to = MIN(pane->damage_to, first_row + pane->rows);
+
+   pane->damage_from = 0;
+   pane->damage_to = 0;
+
+   if (from >= to) {
+      return;
+   }
+
+   U32 from_row = U32(from - first_row);
+   U32 to_row = U32(to - first_row);
 
-   RenderRange range = render_pane(gm, cells, pane);
-   apply_syntax_highlighting(pane, cells, pane->scroll_offset, pane->scroll_offset + pane->rows, range);
+   Cell *cells = grid->cells + from_row * pane->cols;
+   U64 size = U64(to_row - from_row) * pane->cols * sizeof(Cell);
+   MEM_SET(cells, 0, size);
 
-   glBufferData(GL_SHADER_STORAGE_BUFFER, cells_size, cells, GL_DYNAMIC_DRAW);
+   render_pane(gm, grid->cells, pane, from_row, to_row);
+   apply_syntax_highlighting(pane, grid->cells, from_row, to_row);
+
+   if (pane->load && to_row == pane->rows) {
+      render_load_progress(gm, grid->cells, pane);
+   }
+
+   glBindBuffer(GL_SHADER_STORAGE_BUFFER, grid->ssbo);
+   glBufferSubData(GL_SHADER_STORAGE_BUFFER, (U64)from_row * pane->cols * sizeof(Cell), size, cells);
+
+   grid->bytes_uploaded = size;
+   add_dirty_cells(&grid->dirty, {0, from_row, pane->cols, to_row - from_row});
 }
 
 intern void
@@ -287,25 +540,127 @@ render_to_screen(Renderer r, OutputTexture tex)
    glUseProgram(0);
 }
 
+intern GpuTimer
+create_gpu_timer()
+{
+   GpuTimer t = {};
+   glGenQueries(GPU_TIMER_QUERIES, t.queries);
+
+   return t;
+}
+
+intern void
+destroy_gpu_timer(GpuTimer *t)
+{
+   glDeleteQueries(GPU_TIMER_QUERIES, t->queries);
+}
+
 intern void
-render_to_texture(GFX_Shader compute_shader, OutputTexture tex, GLuint glyph_map_texture)
+gpu_timer_resolve(GpuTimer *t)
+{
+   while (t->resolved < t->issued) {
+      GLuint query = t->queries[t->resolved % GPU_TIMER_QUERIES];
+
+      GLint available = 0;
+      glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available) {
+         break;
+      }
+
+      GLuint64 ns = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+
+      t->total_ns += ns;
+      t->samples++;
+      t->resolved++;
+   }
+}
+
+intern B32
+gpu_timer_begin(GpuTimer *t)
+{
+   gpu_timer_resolve(t);
+
+   // every query is still in flight, skip measuring this frame
+   if (t->issued - t->resolved == GPU_TIMER_QUERIES) {
+      return 0;
+   }
+
+   glBeginQuery(GL_TIME_ELAPSED, t->queries[t->issued % GPU_TIMER_QUERIES]);
+
+   return 1;
+}
+
+intern void
+gpu_timer_end(GpuTimer *t)
+{
+   glEndQuery(GL_TIME_ELAPSED);
+   t->issued++;
+}
+
+// the fragment pipeline, every pixel of the window is shaded from the cells
+intern void
+render_cells_to_screen(Renderer r, RenderSize *rs, GLuint glyph_map_texture, U32 screen_height, B32 blink_hidden)
+{
+   glUseProgram(r.cell_shader.id);
+
+   glUniform2ui(r.cell_size_loc, rs->cell_width, rs->cell_height);
+   glUniform2ui(r.grid_size_loc, rs->cols, rs->rows);
+   glUniform1ui(r.screen_height_loc, screen_height);
+   glUniform1ui(r.blink_hidden_loc, blink_hidden);
+
+   glActiveTexture(GL_TEXTURE1);
+   glBindTexture(GL_TEXTURE_2D, glyph_map_texture);
+
+   glBindVertexArray(r.vao);
+   glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+   glBindVertexArray(0);
+
+   glBindTexture(GL_TEXTURE_2D, 0);
+   glUseProgram(0);
+}
+
+// shades the 16x16 tiles that cover the dirty cells
+intern void
+render_to_texture(GFX_Shader compute_shader, OutputTexture tex, GLuint glyph_map_texture, RenderSize *rs, DirtyCells *dirty, B32 blink_hidden)
 {
    glUseProgram(compute_shader.id);
 
-   glBindImageTexture(0, tex.id, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+   glUniform1ui(rs->blink_hidden_loc, blink_hidden);
+
+   glBindImageTexture(0, tex.id, 0, GL_FALSE, 0, GL_WRITE_ONLY, output_formats[tex.format].internal_format);
 
    glActiveTexture(GL_TEXTURE1);
    glBindTexture(GL_TEXTURE_2D, glyph_map_texture);
-   U32 dx = (tex.width + 15) / 16;
-   U32 dy = (tex.height + 15) / 16;
-   glDispatchCompute(dx, dy, 1);
+
+   for (U32 i = 0; i < dirty->count; ++i) {
+      CellRect r = dirty->rects[i];
+
+      U32 x0 = MIN(r.col * rs->cell_width, tex.width);
+      U32 y0 = MIN(r.row * rs->cell_height, tex.height);
+      U32 x1 = MIN((r.col + r.cols) * rs->cell_width, tex.width);
+      U32 y1 = MIN((r.row + r.rows) * rs->cell_height, tex.height);
+
+      U32 tx = x0 / COMPUTE_TILE_SIZE;
+      U32 ty = y0 / COMPUTE_TILE_SIZE;
+      U32 dx = (x1 + COMPUTE_TILE_SIZE - 1) / COMPUTE_TILE_SIZE - tx;
+      U32 dy = (y1 + COMPUTE_TILE_SIZE - 1) / COMPUTE_TILE_SIZE - ty;
+
+      if (dx == 0 || dy == 0) {
+         continue;
+      }
+
+      glUniform2ui(rs->pixel_offset_loc, tx * COMPUTE_TILE_SIZE, ty * COMPUTE_TILE_SIZE);
+      glDispatchCompute(dx, dy, 1);
+   }
 
    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
    glBindTexture(GL_TEXTURE_2D, 0);
    glUseProgram(0);
-}
 
+   dirty->count = 0;
+}
 
 intern void
 init_render_size(RenderSize *rs, GFX_Shader s)
@@ -314,6 +669,8 @@ init_render_size(RenderSize *rs, GFX_Shader s)
 
    rs->cell_size_loc = glGetUniformLocation(s.id, "cell_size");
    rs->grid_size_loc = glGetUniformLocation(s.id, "grid_size");
+   rs->pixel_offset_loc = glGetUniformLocation(s.id, "pixel_offset");
+   rs->blink_hidden_loc = glGetUniformLocation(s.id, "blink_hidden");
 
    glUseProgram(0);
 }
@@ -330,6 +687,8 @@ update_render_size(RenderSize *rs, GlyphMap *gm, GFX_Shader s, U32 window_width,
 
    rs->cols = cols;
    rs->rows = rows;
+   rs->cell_width = m.width;
+   rs->cell_height = m.height;
 
    glUniform2ui(rs->cell_size_loc, m.width, m.height);
    glUniform2ui(rs->grid_size_loc, cols, rows);
@@ -338,15 +697,32 @@ update_render_size(RenderSize *rs, GlyphMap *gm, GFX_Shader s, U32 window_width,
 }
 
 intern OutputTexture
-create_output_texture()
+create_output_texture(U32 format)
 {
    OutputTexture tex = {};
+   tex.format = format;
 
    glGenTextures(1, &tex.id);
 
    return tex;
 }
 
+intern void
+destroy_output_texture(OutputTexture tex)
+{
+   glDeleteTextures(1, &tex.id);
+}
+
+// the compute shader writes in the image format of the output texture
+intern GFX_Shader
+load_output_shader(U32 format)
+{
+   char defines[64];
+   int len = snprintf(defines, sizeof(defines), "#define OUTPUT_FORMAT %s\n", output_formats[format].name);
+
+   return load_compute_shader(String8("assets/compute_shader.glsl"), String8((U8 *)defines, (U64)len));
+}
+
 intern void
 resize_output_texture(OutputTexture *ot, U32 width, U32 height)
 {
@@ -354,7 +730,7 @@ resize_output_texture(OutputTexture *ot, U32 width, U32 height)
    ot->height = height;
 
    glBindTexture(GL_TEXTURE_2D, ot->id);
-   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, 0);
+   glTexImage2D(GL_TEXTURE_2D, 0, output_formats[ot->format].internal_format, width, height, 0, GL_RGBA, GL_FLOAT, 0);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -363,18 +739,27 @@ resize_output_texture(OutputTexture *ot, U32 width, U32 height)
    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+intern void
+set_glyph_map_uniforms(GFX_Shader s)
+{
+   glUseProgram(s.id);
+   glUniform1i(glGetUniformLocation(s.id, "glyph_map"), 1);
+   glUniform1ui(glGetUniformLocation(s.id, "glyph_map_cols"), GM_COUNT_X);
+   glUseProgram(0);
+}
+
 intern GLuint
 create_glyph_map_texture(GFX_Shader s)
 {
    GLuint tex;
 
+   set_glyph_map_uniforms(s);
+
    glUseProgram(s.id);
-   GLuint uniform_slot = glGetUniformLocation(s.id, "glyph_map");
 
    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
 	glGenTextures(1, &tex);
-	glUniform1i(uniform_slot, 1);
 	glActiveTexture(GL_TEXTURE1);
 	glBindTexture(GL_TEXTURE_2D, tex);
 
@@ -388,43 +773,111 @@ create_glyph_map_texture(GFX_Shader s)
    return tex;
 }
 
+intern GLuint
+create_palette_buffer()
+{
+   // std140 pads every array element to a vec4
+   float colors[PALETTE_SIZE][4] = {};
+   for (U32 i = 0; i < COLOR_COUNT; ++i) {
+      U32 c = palette_colors[i];
+      colors[i][0] = float((c >> 16) & 0xFF) / 255.0f;
+      colors[i][1] = float((c >> 8) & 0xFF) / 255.0f;
+      colors[i][2] = float(c & 0xFF) / 255.0f;
+      colors[i][3] = 1.0f;
+   }
+
+   GLuint ubo;
+   glGenBuffers(1, &ubo);
+   glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+   glBufferData(GL_UNIFORM_BUFFER, sizeof(colors), colors, GL_STATIC_DRAW);
+   glBindBufferBase(GL_UNIFORM_BUFFER, PALETTE_BINDING, ubo);
+   glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+   return ubo;
+}
+
+// uploads the glyphs rasterized since the last call
 intern void
 update_glyph_map_texture(GLuint tex, GlyphMap *gm)
 {
-   glBindTexture(GL_TEXTURE_2D, tex);
+   if (!gm->upload_all && gm->upload_count == 0) {
+      return;
+   }
+
    glActiveTexture(GL_TEXTURE1);
+   glBindTexture(GL_TEXTURE_2D, tex);
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+   if (gm->upload_all) {
+      glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, gm->width / 3, gm->height, 0, GL_RGB, GL_UNSIGNED_BYTE, gm->data);
+   } else {
+      U32 w = gm->metrics.width;
+      U32 h = gm->metrics.height;
+
+      glPixelStorei(GL_UNPACK_ROW_LENGTH, gm->width / 3);
+
+      for (U32 i = 0; i < gm->upload_count; ++i) {
+         U32 x = (gm->uploads[i] % GM_COUNT_X) * w;
+         U32 y = (gm->uploads[i] / GM_COUNT_X) * h;
+
+         U8 *src = gm->data + y * gm->width + x * 3;
+         glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGB, GL_UNSIGNED_BYTE, src);
+      }
 
-	glTexImage2D(
-		GL_TEXTURE_2D,
-		0,
-		GL_RGB,
-		gm->width / 3,
-		gm->height,
-		0,
-		GL_RGB,
-		GL_UNSIGNED_BYTE,
-		gm->data	
-	);
+      glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+   }
+
+   gm->upload_all = 0;
+   gm->upload_count = 0;
 
    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 intern void
-load_file(Editor *ed, String8 path, Arena *arena)
+load_file(Editor *ed, String8 path)
 {
+   String8 file = os_map_file(path);
+   if (!file.ptr) {
+      log_error("File '%.*s' does not exist\n", (int)path.len, path.ptr);
+      return;
+   }
+
    Pane p = ed->pane;
    U32 rows = p.rows;
    U32 cols = p.cols;
 
+   U32 backend = p.buffer.backend;
+   if (file.len >= MAPPED_FILE_SIZE) {
+      backend = BUFFER_PIECE_TREE;
+   }
+
    destroy_pane(p);
 
-   Pane np = create_pane(MEGA_BYTES(512), cols, rows);
+   // leaves room for copying every page in case they all hold a '\r'
+   Pane np = create_pane(MAX(MEGA_BYTES(512), file.len * 2), cols, rows, backend);
 
-   load_source_file(&np.buffer, path, arena);
+   np.load = buffer_load_begin(&np.buffer, file, 1);
 
    ed->pane = np;
 }
 
+// takes over what the loader has published, the first parse waits until
+// the whole file is there
+intern void
+poll_file_load(Editor *ed)
+{
+   Pane *p = &ed->pane;
+
+   if (buffer_load_poll(p->load, &p->buffer)) {
+      p->load = 0;
+      p->highlighter.dirty = 1;
+   }
+
+   // new text and the progress in the last row
+   pane_damage_all(p);
+}
+
 intern void
 dispatch_key_event(Editor *ed)
 {
@@ -437,26 +890,56 @@ dispatch_key_event(Editor *ed)
    }
 }
 
+// the cell grid follows the window size and the cell size of the glyph map
 intern void
-on_resize(void *_ctx, int width, int height)
+update_grid_size(WinEventCtx *ctx, U32 width, U32 height)
 {
-   WinEventCtx *ctx = (WinEventCtx *) _ctx;
-
    RenderSize *rs = ctx->render_size;
-   OutputTexture *ot = ctx->output_texture;
-   GlyphMap *gm = ctx->glyph_map;
-   GFX_Shader cs = ctx->compute_shader;
-   Cell *cells = ctx->cells;
    Pane *p = &ctx->editor->pane;
 
+   update_render_size(rs, ctx->glyph_map, ctx->compute_shader, width, height);
+
+   p->cols = rs->cols;
+   p->rows = rs->rows;
+
+   resize_cell_grid(ctx->grid, p, rs->cols, rs->rows);
+   ctx->redraw = 1;
+}
+
+intern void
+on_resize(void *_ctx, int width, int height)
+{
+   WinEventCtx *ctx = (WinEventCtx *) _ctx;
+
    glViewport(0, 0, width, height);
 
-   update_render_size(rs, gm, cs, width, height);
+   resize_output_texture(ctx->output_texture, width, height);
+   update_grid_size(ctx, width, height);
+}
 
-   resize_output_texture(ot, width, height);
+// takes the atlas of the zoom level once the builder has it, until then
+// frames keep the current size
+intern void
+poll_zoom(WinEventCtx *ctx)
+{
+   GlyphAtlasSet *atlases = ctx->atlases;
+   if (!switch_glyph_atlas(atlases)) {
+      return;
+   }
 
-   p->cols = rs->cols;
-   p->rows = rs->rows;
+   ctx->glyph_map = &atlases->maps[atlases->level];
+
+   // the texture holds the atlas of the previous level
+   ctx->glyph_map->upload_all = 1;
+
+   update_grid_size(ctx, ctx->window->width, ctx->window->height);
+}
+
+intern void
+on_refresh(void *_ctx)
+{
+   WinEventCtx *ctx = (WinEventCtx *) _ctx;
+   ctx->redraw = 1;
 }
 
 intern void
@@ -469,6 +952,25 @@ on_key_event(void *_ctx, int key, int scancode, int action, int mods)
       return;
    }
 
+   ctx->last_input_time = glfwGetTime();
+
+   if (key == GLFW_KEY_F12) {
+      ctx->pipeline = (ctx->pipeline + 1) % PIPELINE_COUNT;
+      ctx->redraw = 1;
+      return;
+   }
+
+   if (key == GLFW_KEY_F11) {
+      log_arena_stats();
+      return;
+   }
+
+   if ((mods & GLFW_MOD_CONTROL) && (key == GLFW_KEY_EQUAL || key == GLFW_KEY_MINUS)) {
+      zoom_glyph_atlas(ctx->atlases, key == GLFW_KEY_EQUAL ? 1 : -1);
+      poll_zoom(ctx);
+      return;
+   }
+
    if (!(mods & GLFW_MOD_CONTROL) || key >= GLFW_KEY_LEFT_BRACKET) {
       if (GLFW_KEY_SPACE <= key && key <= GLFW_KEY_GRAVE_ACCENT) {
          return;
@@ -515,6 +1017,8 @@ on_char_event(void *_ctx, unsigned int codepoint)
    Editor *ed = ctx->editor;
    Window *win = ctx->window;
 
+   ctx->last_input_time = glfwGetTime();
+
    U32 kcomb = codepoint;
    if ('a' <= kcomb && kcomb <= 'z') {
       kcomb -= 32;
@@ -542,57 +1046,26 @@ on_char_event(void *_ctx, unsigned int codepoint)
    dispatch_key_event(ed);
 }
 
-intern EditPoints
-byte_offsets_to_points(GapBuffer *_buf, U32 start_byte, U32 old_end_byte, U32 new_end_byte)
+intern TSPoint
+ts_point_from_offset(TextBuffer *buf, U32 offset)
 {
-   EditPoints points = {};
-   const GapBuffer buf = *_buf;
-
-   U32 row = 0;
-   U32 column = 0;
-   U32 byte_index = 0;
-   bool start_found = false;
-   bool old_end_found = false;
-   bool new_end_found = false;
-
-   while (byte_index < buf.len && !(start_found && old_end_found && new_end_found)) {
-      if (byte_index == start_byte) {
-         points.start_point.row = row;
-         points.start_point.column = column;
-         start_found = true;
-      }
+   TextPoint p = buffer_point(buf, offset);
 
-      if (byte_index == old_end_byte) {
-         points.old_end_point.row = row;
-         points.old_end_point.column = column;
-         old_end_found = true;
-      }
+   TSPoint point = {};
+   point.row = U32(p.row);
+   point.column = U32(p.col);
 
-      if (byte_index == new_end_byte) {
-         points.new_end_point.row = row;
-         points.new_end_point.column = column;
-         new_end_found = true;
-      }
-
-      if (buf[byte_index] == '\n') {
-         row++;
-         column = 0;
-      } else {
-         column++;
-      }
-
-      byte_index++;
-   }
+   return point;
+}
 
-   if (!old_end_found) {
-      points.old_end_point.row = row;
-      points.old_end_point.column = column;
-   }
+intern EditPoints
+byte_offsets_to_points(TextBuffer *buf, U32 start_byte, U32 old_end_byte, U32 new_end_byte)
+{
+   EditPoints points = {};
 
-   if (!new_end_found) {
-      points.new_end_point.row = row;
-      points.new_end_point.column = column;
-   }
+   points.start_point = ts_point_from_offset(buf, start_byte);
+   points.old_end_point = ts_point_from_offset(buf, old_end_byte);
+   points.new_end_point = ts_point_from_offset(buf, new_end_byte);
    
    return points;
 }
@@ -602,53 +1075,286 @@ ed_on_text_change(Editor *ed, Edit edit) {
    Pane *p = &ed->pane;
    SyntaxHighlighter *hl = &p->highlighter;
 
+   // the buffer is read only until the load finished and parsed it
+   if (p->load) {
+      return;
+   }
+
+   U32 start_byte = 0;
+   U32 old_end_byte = 0;
+   U32 new_end_byte = 0;
+
+   if (edit.pos_after > edit.pos_before) {
+      start_byte = U32(edit.pos_before);
+      old_end_byte = start_byte;
+      new_end_byte = U32(edit.pos_after);
+   } else {
+      start_byte = U32(edit.pos_after);
+      old_end_byte = U32(edit.pos_before);
+      new_end_byte = start_byte;
+   }
+
+   EditPoints points = byte_offsets_to_points(&p->buffer, start_byte, old_end_byte, new_end_byte);
+
+   const TSInputEdit tsie = {
+      start_byte,
+      old_end_byte,
+      new_end_byte,
+      points.start_point,
+      points.old_end_point,
+      points.new_end_point
+   };
+
+   // the current tree stays in use until the worker publishes a new one
    if (hl->tree) {
-      U32 start_byte = 0;
-      U32 old_end_byte = 0;
-      U32 new_end_byte = 0;
-
-      if (edit.pos_after > edit.pos_before) {
-         start_byte = U32(edit.pos_before);
-         old_end_byte = start_byte;
-         new_end_byte = U32(edit.pos_after);
-      } else {
-         start_byte = U32(edit.pos_after);
-         old_end_byte = U32(edit.pos_before);
-         new_end_byte = start_byte;
+      ts_tree_edit(hl->tree, &tsie);
+   }
+
+   U64 row = points.start_point.row;
+   U64 to_row = highlight_cache_edit(&hl->cache, row, buffer_line_count(&p->buffer));
+   pane_damage_rows(p, row, to_row);
+
+   parse_worker_edit(hl->worker, tsie);
+   hl->dirty = 1;
+}
+
+enum
+{
+   BENCH_WIDTH = 3840,
+   BENCH_HEIGHT = 2160,
+   BENCH_FRAMES = 200,
+};
+
+// kilobytes of video memory still free, 0 when the driver does not say
+intern U64
+available_video_memory()
+{
+   if (!GLEW_NVX_gpu_memory_info) {
+      return 0;
+   }
+
+   GLint kb = 0;
+   glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &kb);
+
+   return (U64)kb;
+}
+
+// a few scripts worth of glyphs, rasterized one by one and on the pool
+intern void
+bench_glyph_rasterization(FT_Library freetype, Arena *arena)
+{
+   TempArena temp = begin_temp_arena(arena);
+
+   U32 ranges[][2] = {
+      {0x21, 0x7E}, {0xA1, 0x17F}, {0x370, 0x3FF}, {0x400, 0x4FF}, {0x2500, 0x257F},
+   };
+
+   U32 *codepoints = push_array(temp.arena, U32, GM_SLOT_COUNT);
+   U32 *slots = push_array(temp.arena, U32, GM_SLOT_COUNT);
+   U32 count = 0;
+   for (U32 r = 0; r < ARRAY_COUNT(ranges); ++r) {
+      for (U32 cp = ranges[r][0]; cp <= ranges[r][1]; ++cp) {
+         codepoints[count++] = cp;
       }
+   }
 
-      EditPoints points = byte_offsets_to_points(&p->buffer, start_byte, old_end_byte, new_end_byte);
+   GlyphMap serial = load_glyphmap(temp.arena, "assets/consolas.ttf", 16, freetype);
+   GlyphMap parallel = load_glyphmap(temp.arena, "assets/consolas.ttf", 16, freetype);
+   clear_glyphmap(&serial);
+   clear_glyphmap(&parallel);
 
-      const TSInputEdit tsie = {
-         start_byte,
-         old_end_byte,
-         new_end_byte,
-         points.start_point,
-         points.old_end_point,
-         points.new_end_point
-      };
+   GlyphPool *pool = create_glyph_pool(&parallel, os_processor_count() - 1);
 
-      ts_tree_edit(hl->tree, &tsie);
+   U64 serial_start = os_now_microseconds();
+   load_glyphs(&serial, 0, codepoints, count, slots);
+   U64 serial_time = os_now_microseconds() - serial_start;
+
+   U64 parallel_start = os_now_microseconds();
+   load_glyphs(&parallel, pool, codepoints, count, slots);
+   U64 parallel_time = os_now_microseconds() - parallel_start;
+
+   B32 same = memcmp(serial.data, parallel.data, U64(serial.width) * serial.height) == 0;
+
+   log_info("%u glyphs, serial %llu us, %u threads %llu us, atlas %s",
+            count, serial_time, pool->thread_count + 1, parallel_time, same ? "identical" : "DIFFERS");
+
+   destroy_glyph_pool(pool);
+   release_glyphmap(&serial);
+   release_glyphmap(&parallel);
+
+   end_temp_arena(temp);
+}
+
+// full 4K frames in every output format: the compute pass and the pass
+// that samples its texture, drawn into an offscreen framebuffer. The
+// fragment pipeline runs last for comparison.
+intern void
+bench_output_formats(GlyphMap *gm, Renderer renderer, GLuint glyph_map_texture, Arena *arena)
+{
+   TempArena temp = begin_temp_arena(arena);
+
+   GLuint fbo, color;
+   glGenFramebuffers(1, &fbo);
+   glGenRenderbuffers(1, &color);
+   glBindRenderbuffer(GL_RENDERBUFFER, color);
+   glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, BENCH_WIDTH, BENCH_HEIGHT);
+   glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+   glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+   glViewport(0, 0, BENCH_WIDTH, BENCH_HEIGHT);
+
+   // a screen full of text
+   U32 cols = BENCH_WIDTH / gm->metrics.width;
+   U32 rows = BENCH_HEIGHT / gm->metrics.height;
+
+   Cell *cells = push_array(temp.arena, Cell, cols * rows);
+   for (U32 i = 0; i < cols * rows; ++i) {
+      cells[i] = {};
+      cells[i].glyph = U16(load_glyph(gm, ' ' + i % 95));
+      cells[i].fg = U8(COLOR_FOREGROUND + i % (COLOR_COUNT - 1));
+   }
+
+   update_glyph_map_texture(glyph_map_texture, gm);
+
+   GLuint ssbo;
+   glGenBuffers(1, &ssbo);
+   glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+   glBufferData(GL_SHADER_STORAGE_BUFFER, U64(cols) * rows * sizeof(Cell), cells, GL_STATIC_DRAW);
+   glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, ssbo);
+
+   GLuint query;
+   glGenQueries(1, &query);
+
+   log_info("%ux%u, %ux%u cells, %u frames", BENCH_WIDTH, BENCH_HEIGHT, cols, rows, BENCH_FRAMES);
+
+   for (U32 format = 0; format < OUTPUT_FORMAT_COUNT; ++format) {
+      GFX_Shader cs = load_output_shader(format);
+      set_glyph_map_uniforms(cs);
+
+      RenderSize rs = {};
+      init_render_size(&rs, cs);
+      update_render_size(&rs, gm, cs, BENCH_WIDTH, BENCH_HEIGHT);
+
+      glFinish();
+      U64 free_before = available_video_memory();
+
+      OutputTexture tex = create_output_texture(format);
+      resize_output_texture(&tex, BENCH_WIDTH, BENCH_HEIGHT);
+
+      DirtyCells dirty = {};
+
+      // the first frame warms up and is not measured
+      for (U32 frame = 0; frame <= BENCH_FRAMES; ++frame) {
+         if (frame == 1) {
+            glBeginQuery(GL_TIME_ELAPSED, query);
+         }
+
+         add_dirty_cells(&dirty, {0, 0, cols, rows});
+         render_to_texture(cs, tex, glyph_map_texture, &rs, &dirty, 0);
+         render_to_screen(renderer, tex);
+      }
+      glEndQuery(GL_TIME_ELAPSED);
+
+      GLuint64 ns = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+
+      U64 free_after = available_video_memory();
+      double texture_mb = (double)BENCH_WIDTH * (double)BENCH_HEIGHT * output_formats[format].bytes_per_pixel / (double)MEGA_BYTES(1);
+      double measured_mb = free_before > free_after ? (double)(free_before - free_after) / 1024.0 : 0.0;
+
+      log_info("%-8s %8.3f ms/f %8.1f MB texture %8.1f MB vram used",
+               output_formats[format].name, (double)ns / 1000000.0 / (double)BENCH_FRAMES, texture_mb, measured_mb);
+
+      destroy_output_texture(tex);
+      unload_shader(cs);
    }
 
-   TempArena temp = begin_temp_arena(ed->general_arena);
-   update_syntax_highlighting(p, temp.arena);
+   // no texture in between
+   RenderSize rs = {};
+   rs.cols = cols;
+   rs.rows = rows;
+   rs.cell_width = gm->metrics.width;
+   rs.cell_height = gm->metrics.height;
+
+   for (U32 frame = 0; frame <= BENCH_FRAMES; ++frame) {
+      if (frame == 1) {
+         glBeginQuery(GL_TIME_ELAPSED, query);
+      }
+
+      render_cells_to_screen(renderer, &rs, glyph_map_texture, BENCH_HEIGHT, 0);
+   }
+   glEndQuery(GL_TIME_ELAPSED);
+
+   GLuint64 ns = 0;
+   glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+   log_info("%-8s %8.3f ms/f", pipeline_names[PIPELINE_FRAGMENT], (double)ns / 1000000.0 / (double)BENCH_FRAMES);
+
+   glDeleteQueries(1, &query);
+   glDeleteBuffers(1, &ssbo);
+   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+   glDeleteRenderbuffers(1, &color);
+   glDeleteFramebuffers(1, &fbo);
+
    end_temp_arena(temp);
 }
 
 int
 main(int argc, char **argv)
 {
+   U32 buffer_backend = BUFFER_GAP;
+   U32 output_format = OUTPUT_RGBA8;
+   U32 pipeline = PIPELINE_COMPUTE;
+   B32 bench_output = 0;
+   B32 bench_startup = 0;
+   B32 bench_glyphs = 0;
+
+   U64 start_time = os_now_microseconds();
+
+   for (int i = 1; i < argc; ++i) {
+      String8 arg = String8(argv[i]);
+
+      if (arg == "--piece-tree") {
+         buffer_backend = BUFFER_PIECE_TREE;
+      } else if (arg == "--output-format" && i + 1 < argc) {
+         String8 name = String8(argv[++i]);
+
+         U32 format = 0;
+         while (format < OUTPUT_FORMAT_COUNT && name != output_formats[format].name) {
+            format++;
+         }
+
+         if (format < OUTPUT_FORMAT_COUNT) {
+            output_format = format;
+         } else {
+            log_error("Unknown output format '%s'", argv[i]);
+         }
+      } else if (arg == "--fragment-pipeline") {
+         pipeline = PIPELINE_FRAGMENT;
+      } else if (arg == "--bench-output") {
+         bench_output = 1;
+      } else if (arg == "--bench-startup") {
+         bench_startup = 1;
+      } else if (arg == "--bench-glyphs") {
+         bench_glyphs = 1;
+      } else if (arg == "--fallback-font" && i + 1 < argc) {
+         add_glyph_fallback_font(argv[++i]);
+      } else {
+         log_error("Unknown argument '%s'", argv[i]);
+      }
+   }
+
    Arena arena = {};
    init_arena(&arena, GIGA_BYTES(4));
+   arena_set_name(&arena, "main");
 
    Arena cell_arena = {};
    sub_arena(&cell_arena, &arena, MEGA_BYTES(512));
+   arena_set_name(&cell_arena, "cells");
 
    Arena general_arena = {};
    sub_arena(&general_arena, &arena, GIGA_BYTES(2));
+   arena_set_name(&general_arena, "general");
 
-   Pane pane = create_pane(GIGA_BYTES(1), 0, 0);
+   Pane pane = create_pane(GIGA_BYTES(1), 0, 0, buffer_backend);
 
    Editor editor = {};
    editor.mode = ED_NORMAL;
@@ -657,90 +1363,240 @@ main(int argc, char **argv)
 
    create_default_keymaps(&editor, &general_arena);
    
+   U64 font_start = os_now_microseconds();
    FT_Library freetype = init_freetype();
-   GlyphMap glyph_map = load_glyphmap(&arena, "assets/consolas.ttf", 16, freetype);
+   GlyphAtlasSet *atlases = push_struct(&arena, GlyphAtlasSet);
+   init_glyph_atlas_set(atlases, &arena, "assets/consolas.ttf", 16, freetype);
+   GlyphMap *glyph_map = &atlases->maps[atlases->level];
+
+   GlyphPool *glyph_pool = create_glyph_pool(glyph_map, os_processor_count() - 1);
+
+   // without a cached atlas the printable ascii is rasterized up front on all cores
+   if (!glyph_map->cache_hit) {
+      U32 ascii[0x7F - 0x21];
+      U32 ascii_slots[0x7F - 0x21];
+      for (U32 i = 0; i < ARRAY_COUNT(ascii); ++i) {
+         ascii[i] = 0x21 + i;
+      }
 
+      load_glyphs(glyph_map, glyph_pool, ascii, ARRAY_COUNT(ascii), ascii_slots);
+   }
+   U64 font_time = os_now_microseconds() - font_start;
+
+   if (bench_glyphs) {
+      bench_glyph_rasterization(freetype, &arena);
+      return 0;
+   }
+
+   U64 window_start = os_now_microseconds();
    Window window = {};
    init_window(&window, "Ayed");
 
    init_gfx();
+   U64 window_time = os_now_microseconds() - window_start;
+
+   U64 gpu_start = os_now_microseconds();
 
-   GFX_Shader compute_shader = load_compute_shader(String8("assets/compute_shader.glsl"), &arena);
+   GFX_Shader compute_shader = load_output_shader(output_format);
 
-   Renderer renderer = create_renderer(&arena);
+   Renderer renderer = create_renderer();
 
-   OutputTexture output_texture = create_output_texture();
+   OutputTexture output_texture = create_output_texture(output_format);
 
    RenderSize render_size = {};
    init_render_size(&render_size, compute_shader);
 
    GLuint glyph_map_texture = create_glyph_map_texture(compute_shader);
-   update_glyph_map_texture(glyph_map_texture, &glyph_map);
+   GLuint palette_buffer = create_palette_buffer();
+   set_glyph_map_uniforms(renderer.cell_shader);
+   update_glyph_map_texture(glyph_map_texture, glyph_map);
+   U64 gpu_time = os_now_microseconds() - gpu_start;
+
+   if (bench_output) {
+      bench_output_formats(glyph_map, renderer, glyph_map_texture, &arena);
+      destroy_window(&window);
+      return 0;
+   }
 
-   GLuint cells_ssbo;
-   glGenBuffers(1, &cells_ssbo);
-   glBindBuffer(GL_SHADER_STORAGE_BUFFER, cells_ssbo);
-   glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, cells_ssbo);
+   CellGrid grid = {};
+   glGenBuffers(1, &grid.ssbo);
+   glBindBuffer(GL_SHADER_STORAGE_BUFFER, grid.ssbo);
+   glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, grid.ssbo);
 
-   Cell *cells = push_array(&cell_arena, Cell, cell_arena.size / sizeof(Cell));
+   grid.cells = (Cell *)cell_arena.ptr;
+   grid.cells_cap = cell_arena.size;
 
    WinEventCtx win_event_ctx = {};
    win_event_ctx.render_size = &render_size;
    win_event_ctx.output_texture = &output_texture;
-   win_event_ctx.glyph_map = &glyph_map;
+   win_event_ctx.glyph_map = glyph_map;
+   win_event_ctx.atlases = atlases;
    win_event_ctx.compute_shader = compute_shader;
-   win_event_ctx.cells_ssbo = cells_ssbo;
-   win_event_ctx.cells = cells;
+   win_event_ctx.grid = &grid;
    win_event_ctx.editor = &editor;
    win_event_ctx.window = &window;
+   win_event_ctx.pipeline = pipeline;
 
    WindowCallbacks win_callbacks = {};
    win_callbacks.ctx = &win_event_ctx;
    win_callbacks.resize = on_resize;
    win_callbacks.key = on_key_event;
    win_callbacks.text = on_char_event;
+   win_callbacks.refresh = on_refresh;
 
    set_window_callbacks(&window, win_callbacks);
    on_resize(&win_event_ctx, window.width, window.height);
 
-   load_file(&editor, String8("editor/editor.cpp"), &general_arena);
+   load_file(&editor, String8("editor/editor.cpp"));
 
    glfwSwapInterval(1);
 
+   // finished parses wake the loop, everything else arrives as an event
+   parse_worker_set_wake(wake_window);
+
+   // the pool rasterizes for the builder from here on
+   start_glyph_atlas_builder(atlases, glyph_pool, wake_window);
+
+   GpuTimer shade_timer = create_gpu_timer();
+
    U64 fps = 0;
+   U64 wakeups = 0;
+   U64 bytes_uploaded = 0;
    double last_time_fps = glfwGetTime();
+   U64 last_cpu_time = os_process_cpu_microseconds();
+
+   win_event_ctx.last_input_time = glfwGetTime();
+   win_event_ctx.redraw = 1;
+   B32 drawn_blink_hidden = 0;
 
    while (!should_close_window(&window)) {
-      glClear(GL_COLOR_BUFFER_BIT);
+      // sleep until something changes: input and resizes are events, parses
+      // post one, the blink and a loading file need a timer
+      double now = glfwGetTime();
+      double since_input = now - win_event_ctx.last_input_time;
+      double timeout = (floor(since_input / BLINK_INTERVAL) + 1) * BLINK_INTERVAL - since_input;
+
+      if (editor.pane.load) {
+         timeout = MIN(timeout, LOAD_POLL_INTERVAL);
+      }
+
+      wait_window_events(&window, timeout);
+      wakeups++;
+
+      if (editor.pane.load) {
+         poll_file_load(&editor);
+      }
+
+      poll_syntax_highlighting(&editor.pane);
+
+      poll_zoom(&win_event_ctx);
+      glyph_map = win_event_ctx.glyph_map;
 
-      render_to_cells(&glyph_map, cells, &render_size, &editor);
-      render_to_texture(compute_shader, output_texture, glyph_map_texture);
-      render_to_screen(renderer, output_texture);
+      render_to_cells(glyph_map, &grid, &editor);
+      bytes_uploaded += grid.bytes_uploaded;
+
+      update_glyph_map_texture(glyph_map_texture, glyph_map);
+
+      // glyphs were evicted while rendering, the next frame follows right away
+      if (glyph_map->evictions != grid.glyph_evictions) {
+         wake_window();
+      }
+
+      since_input = glfwGetTime() - win_event_ctx.last_input_time;
+      B32 blink_hidden = U64(since_input / BLINK_INTERVAL) & 1;
+
+      if (win_event_ctx.redraw) {
+         add_dirty_cells(&grid.dirty, {0, 0, render_size.cols, render_size.rows});
+         win_event_ctx.redraw = 0;
+      }
+
+      if (blink_hidden != drawn_blink_hidden) {
+         add_dirty_cells(&grid.dirty, cursor_cell(&editor.pane));
+         drawn_blink_hidden = blink_hidden;
+      }
+
+      gpu_timer_resolve(&shade_timer);
+
+      if (grid.dirty.count) {
+         glClear(GL_COLOR_BUFFER_BIT);
+
+         // the timer covers the pass that shades the cells
+         B32 timed = gpu_timer_begin(&shade_timer);
+
+         if (win_event_ctx.pipeline == PIPELINE_COMPUTE) {
+            render_to_texture(compute_shader, output_texture, glyph_map_texture, &render_size, &grid.dirty, blink_hidden);
+            if (timed) {
+               gpu_timer_end(&shade_timer);
+            }
+
+            render_to_screen(renderer, output_texture);
+         } else {
+            render_cells_to_screen(renderer, &render_size, glyph_map_texture, window.height, blink_hidden);
+            if (timed) {
+               gpu_timer_end(&shade_timer);
+            }
+
+            grid.dirty.count = 0;
+         }
+
+         swap_window(&window);
+
+         fps++;
+
+         if (bench_startup) {
+            glFinish();
+
+            U64 now_us = os_now_microseconds();
+            log_info("glyph cache %s, font setup %llu us, window creation %llu us, gpu setup %llu us",
+                     glyph_map->cache_hit ? "hit" : "miss", font_time, window_time, gpu_time);
+            log_info("first frame at %llu us, %llu glyphs rasterized", now_us - start_time, glyph_map->rasterized);
+            break;
+         }
+      }
 
       double now_time_fps = glfwGetTime();
       double delta_time_fps = now_time_fps - last_time_fps;
       if (delta_time_fps >= 1.0) {
-         char buf[128];
+         char buf[192];
 
-         double mspf = (delta_time_fps * 1000) / (double)fps;
+         double mspf = fps ? (delta_time_fps * 1000) / (double)fps : 0.0;
+         U64 bpf = fps ? bytes_uploaded / fps : 0;
 
-         snprintf(buf, sizeof(buf), "Ayed %llu FPS, %f ms/f", fps, mspf);
+         U64 cpu_time = os_process_cpu_microseconds();
+         double cpu = (double)(cpu_time - last_cpu_time) / (delta_time_fps * 10000.0);
+
+         U64 shade_us = shade_timer.samples ? shade_timer.total_ns / shade_timer.samples / 1000 : 0;
+         shade_timer.total_ns = 0;
+         shade_timer.samples = 0;
+
+         snprintf(buf, sizeof(buf), "Ayed %llu FPS, %f ms/f, %llu B/f uploaded, %llu us/f %s, %.1f%% CPU, %.0f wakeups/s",
+                  (unsigned long long)fps, mspf, (unsigned long long)bpf, (unsigned long long)shade_us, pipeline_names[win_event_ctx.pipeline], cpu, (double)wakeups / delta_time_fps);
          glfwSetWindowTitle(window.handle, buf);
          last_time_fps = now_time_fps;
+         last_cpu_time = cpu_time;
          fps = 0;
+         wakeups = 0;
+         bytes_uploaded = 0;
       }
-
-      fps++;
-
-      update_window(&window);
    }
 
-   glDeleteBuffers(1, &cells_ssbo);
+   // joins the parse worker while the window can still take its wake up
+   destroy_pane(editor.pane);
+   destroy_gpu_timer(&shade_timer);
+
+   glDeleteBuffers(1, &grid.ssbo);
+   glDeleteBuffers(1, &palette_buffer);
 
    destroy_renderer(renderer);
+   destroy_output_texture(output_texture);
    unload_shader(compute_shader);
+   destroy_glyph_atlas_set(atlases);
    release_freetype(freetype);
    destroy_window(&window);
 
+   free_arena(&arena, arena.size);
+   free_thread_scratch();
+   log_arena_stats();
+
    return 0;
 }
\ No newline at end of file
@@ -77,10 +77,12 @@ init_gfx()
 }
 
 GFX_Shader
-load_gfx_shaders(String8 vert_path, String8 frag_path, Arena *arena)
+load_gfx_shaders(String8 vert_path, String8 frag_path)
 {
-   String8 vert_src = os_read_file(vert_path, arena);
-   String8 frag_src = os_read_file(frag_path, arena);
+   TempArena scratch = get_scratch();
+
+   String8 vert_src = os_read_file(vert_path, scratch.arena);
+   String8 frag_src = os_read_file(frag_path, scratch.arena);
 
    if (!vert_src.ptr) {
       log_fatal("File not found: %.*s", (int)vert_path.len, vert_path.ptr);
@@ -92,6 +94,7 @@ load_gfx_shaders(String8 vert_path, String8 frag_path, Arena *arena)
 
    GLuint vert_shader = compile_shader(vert_src, GL_VERTEX_SHADER, "vertex");
    GLuint frag_shader = compile_shader(frag_src, GL_FRAGMENT_SHADER, "fragment");
+   release_scratch(scratch);
 
    GLuint program = glCreateProgram();
 
@@ -114,16 +117,44 @@ load_gfx_shaders(String8 vert_path, String8 frag_path, Arena *arena)
    return GFX_Shader(program);
 }
 
+// the #version line has to stay the first one
+intern String8
+insert_shader_defines(String8 src, String8 defines, Arena *arena)
+{
+   U64 version_end = 0;
+   while (version_end < src.len && src[version_end] != '\n') {
+      version_end++;
+   }
+   version_end = MIN(version_end + 1, src.len);
+
+   String8 out = {};
+   out.len = src.len + defines.len;
+   out.ptr = push_array(arena, U8, out.len);
+
+   MEM_COPY(out.ptr, src.ptr, version_end);
+   MEM_COPY(out.ptr + version_end, defines.ptr, defines.len);
+   MEM_COPY(out.ptr + version_end + defines.len, src.ptr + version_end, src.len - version_end);
+
+   return out;
+}
+
 GFX_Shader
-load_compute_shader(String8 path, Arena *arena)
+load_compute_shader(String8 path, String8 defines)
 {
-   String8 src = os_read_file(path, arena);
+   TempArena scratch = get_scratch();
+
+   String8 src = os_read_file(path, scratch.arena);
 
    if (!src.ptr) {
       log_fatal("File not found: %.*s", (int)path.len, path.ptr);
    }
 
+   if (defines.len) {
+      src = insert_shader_defines(src, defines, scratch.arena);
+   }
+
    GLuint shader = compile_shader(src, GL_COMPUTE_SHADER, "compute");
+   release_scratch(scratch);
 
    GLuint program = glCreateProgram();
 
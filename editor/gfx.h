@@ -7,6 +7,8 @@ struct GFX_Shader
 
 intern void init_gfx();
 
-intern GFX_Shader load_gfx_shaders(String8 vert_path, String8 frag_path, Arena *arena);
-intern GFX_Shader load_compute_shader(String8 path, Arena *arena);
+// the sources are read into scratch memory
+intern GFX_Shader load_gfx_shaders(String8 vert_path, String8 frag_path);
+// defines are inserted after the #version line, e.g. "#define X 1\n"
+intern GFX_Shader load_compute_shader(String8 path, String8 defines=null_str8);
 intern void unload_shader(GFX_Shader shader);
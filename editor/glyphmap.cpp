@@ -7,9 +7,29 @@
 
 enum
 {
-   GM_COUNT_X = 32,
-   GM_COUNT_Y = 16,
-   GM_ASCII_START = ' ',
+   GM_MAX_FALLBACK_FONTS = 16,
+};
+
+global const char *gm_fallback_fonts[GM_MAX_FALLBACK_FONTS];
+global U32 gm_fallback_font_count;
+
+// tried after the ones that were added, the first found fill the faces
+global const char *gm_platform_fallback_fonts[] = {
+#if defined(OS_WINDOWS)
+   "C:/Windows/Fonts/seguisym.ttf",
+   "C:/Windows/Fonts/msyh.ttc",
+   "C:/Windows/Fonts/msgothic.ttc",
+   "C:/Windows/Fonts/malgun.ttf",
+#elif defined(OS_MAC)
+   "/System/Library/Fonts/Menlo.ttc",
+   "/System/Library/Fonts/Hiragino Sans GB.ttc",
+   "/System/Library/Fonts/AppleSDGothicNeo.ttc",
+#else
+   "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf",
+   "/usr/share/fonts/opentype/noto/NotoSansCJK-Regular.ttc",
+   "/usr/share/fonts/noto-cjk/NotoSansCJK-Regular.ttc",
+   "/usr/share/fonts/google-noto-cjk/NotoSansCJK-Regular.ttc",
+#endif
 };
 
 intern GlyphMetrics
@@ -37,7 +57,7 @@ init_freetype()
       log_fatal("Failed to initialize FreeType\n");
    }
 
-   FT_Library_SetLcdFilter(lib, FT_LCD_FILTER_DEFAULT);
+   FT_Library_SetLcdFilter(lib, (FT_LcdFilter)GM_LCD_FILTER);
 
    return lib;
 }
@@ -48,95 +68,831 @@ release_freetype(FT_Library lib)
    FT_Done_FreeType(lib);
 }
 
+void
+add_glyph_fallback_font(const char *path)
+{
+   if (gm_fallback_font_count < GM_MAX_FALLBACK_FONTS) {
+      gm_fallback_fonts[gm_fallback_font_count++] = path;
+   } else {
+      log_error("Too many fallback fonts, ignoring %s", path);
+   }
+}
+
+intern U64
+hash_bytes(U64 h, const void *data, U64 len)
+{
+   // fnv-1a
+   const U8 *bytes = (const U8 *)data;
+   for (U64 i = 0; i < len; ++i) {
+      h = (h ^ bytes[i]) * 0x100000001B3ull;
+   }
+
+   return h;
+}
+
+// the font by its contents, the fallbacks by their path and size so the
+// large ones are not read through for every atlas
+intern U64
+hash_font_files(GlyphMap *gm, const char **font_names)
+{
+   U64 h = hash_bytes(0xCBF29CE484222325ull, gm->font_files[0].ptr, gm->font_files[0].len);
+
+   for (U32 i = 1; i < gm->font_count; ++i) {
+      h = hash_bytes(h, font_names[i], strlen(font_names[i]));
+      h = hash_bytes(h, &gm->font_files[i].len, sizeof(gm->font_files[i].len));
+   }
+
+   return h;
+}
+
+intern void
+glyph_cache_path(GlyphMap *gm, char *buf, U64 size)
+{
+   snprintf(buf, size, "glyphs-%016llx-%u.cache", (unsigned long long)gm->font_hash, gm->font_size);
+}
+
+intern FT_Face
+open_glyph_face(GlyphMap *gm, String8 file)
+{
+   FT_Face face = 0;
+   if (FT_New_Memory_Face(gm->freetype, file.ptr, (FT_Long)file.len, 0, &face) != 0) {
+      return 0;
+   }
+
+   if (FT_Set_Pixel_Sizes(face, 0, gm->font_size) != 0) {
+      FT_Done_Face(face);
+      return 0;
+   }
+
+   return face;
+}
+
+// a fallback that fails keeps its index, the keys in the cache depend on it
+intern void
+load_glyph_faces(GlyphMap *gm)
+{
+   for (U32 i = 0; i < gm->font_count; ++i) {
+      gm->faces[i] = open_glyph_face(gm, gm->font_files[i]);
+      if (!gm->faces[i] && i > 0) {
+         log_error("Failed to load fallback face %u", i);
+      }
+   }
+
+   if (!gm->faces[0]) {
+      log_fatal("Failed to load face\n");
+   }
+
+   gm->face_count = gm->font_count;
+}
+
+intern NKINLINE U32
+glyph_bucket(U32 key)
+{
+   return (key * 0x9E3779B1u) >> 22;
+}
+
+// takes the atlas over from the cache file, returns 0 when the file is
+// missing or was made for another font, size or filter
+intern B32
+load_glyph_cache(GlyphMap *gm, Arena *arena)
+{
+   char path[256];
+   glyph_cache_path(gm, path, sizeof(path));
+
+   String8 file = os_map_file(String8(path));
+   if (!file.ptr) {
+      return 0;
+   }
+
+   GlyphCacheHeader *header = (GlyphCacheHeader *)file.ptr;
+
+   B32 valid = file.len >= sizeof(GlyphCacheHeader) &&
+               header->magic == GM_CACHE_MAGIC &&
+               header->version == GM_CACHE_VERSION &&
+               header->font_hash == gm->font_hash &&
+               header->font_size == gm->font_size &&
+               header->lcd_filter == GM_LCD_FILTER &&
+               header->width == header->metrics.width * GM_COUNT_X * 3 &&
+               header->height == header->metrics.height * GM_COUNT_Y &&
+               header->slots_used >= 1 && header->slots_used <= GM_SLOT_COUNT &&
+               file.len == sizeof(GlyphCacheHeader) + header->slots_used * sizeof(GlyphSlot) + U64(header->width) * header->height;
+
+   GlyphSlot *slots = (GlyphSlot *)(header + 1);
+
+   for (U32 i = 0; valid && i < header->slots_used; ++i) {
+      valid = slots[i].prev < header->slots_used && slots[i].next < header->slots_used;
+   }
+
+   if (!valid) {
+      log_error("Ignoring glyph cache %s", path);
+      os_unmap_file(file);
+      return 0;
+   }
+
+   gm->metrics = header->metrics;
+   gm->width = header->width;
+   gm->height = header->height;
+   gm->data = push_array(arena, U8, U64(gm->width) * gm->height);
+   MEM_COPY(gm->data, (U8 *)(slots + header->slots_used), U64(gm->width) * gm->height);
+
+   gm->slots_used = header->slots_used;
+   MEM_COPY(gm->slots, slots, header->slots_used * sizeof(GlyphSlot));
+
+   for (U32 i = 1; i < gm->slots_used; ++i) {
+      U32 bucket = glyph_bucket(gm->slots[i].key);
+      gm->slots[i].bucket_next = gm->buckets[bucket];
+      gm->buckets[bucket] = (U16)i;
+   }
+
+   os_unmap_file(file);
+   return 1;
+}
+
 GlyphMap
 load_glyphmap(Arena *arena, const char *font_name, U32 font_size, FT_Library freetype)
 {
    GlyphMap gm = {};
 
-   FT_Error err;
-
-   FT_Face face;
-   err = FT_New_Face(freetype, font_name, 0, &face);
-   if (err != 0) {
+   gm.freetype = freetype;
+   gm.font_size = font_size;
+   gm.font_files[0] = os_map_file(String8(font_name));
+   if (!gm.font_files[0].len) {
       log_fatal("Failed to load face\n");
    }
+   gm.font_count = 1;
 
-   err = FT_Set_Pixel_Sizes(face, 0, font_size);
-   if (err != 0) {
-      log_fatal("Failed to set pixel size\n");
+   const char *font_names[GM_MAX_FACES] = {font_name};
+   U32 candidate_count = gm_fallback_font_count + ARRAY_COUNT(gm_platform_fallback_fonts);
+
+   for (U32 i = 0; i < candidate_count && gm.font_count < GM_MAX_FACES; ++i) {
+      const char *name = i < gm_fallback_font_count ? gm_fallback_fonts[i] : gm_platform_fallback_fonts[i - gm_fallback_font_count];
+
+      String8 file = os_map_file(String8(name));
+      if (file.len) {
+         font_names[gm.font_count] = name;
+         gm.font_files[gm.font_count++] = file;
+      } else if (file.ptr) {
+         os_unmap_file(file);
+      }
    }
 
-   gm.metrics = calculate_font_metrics(face);
+   gm.font_hash = hash_font_files(&gm, font_names);
+   gm.cache_hit = load_glyph_cache(&gm, arena);
 
-   gm.width = gm.metrics.width * GM_COUNT_X * 3;
-   gm.height = gm.metrics.height * GM_COUNT_Y;
-   gm.data = push_array(arena, U8, gm.width * gm.height);
+   if (!gm.cache_hit) {
+      load_glyph_faces(&gm);
+      gm.metrics = calculate_font_metrics(gm.faces[0]);
 
-   // Load ascii chars
-   U32 ascii_chars_count = ('~' - GM_ASCII_START) + 1;
+      gm.width = gm.metrics.width * GM_COUNT_X * 3;
+      gm.height = gm.metrics.height * GM_COUNT_Y;
+      gm.data = push_array(arena, U8, gm.width * gm.height);
+      MEM_ZERO(gm.data, gm.width * gm.height);
 
-   for (U32 i = 0; i < ascii_chars_count; ++i) {
-      U32 codepoint = (U32)(GM_ASCII_START + i);
+      // glyphs are rasterized when they are first asked for
+      gm.slots_used = 1;
+   }
 
-      FT_UInt glyph_index = FT_Get_Char_Index(face, codepoint);
-      FT_Int32 load_flags = FT_LOAD_TARGET_LCD;
-      err = FT_Load_Glyph(face, glyph_index, load_flags);
-      if (err != 0) {
-         log_fatal("Failed to load glyph\n");
-      }
+   gm.upload_all = 1;
 
-      FT_Render_Mode render_flags = FT_RENDER_MODE_LCD;
-      err = FT_Render_Glyph(face->glyph, render_flags);
-      if (err != 0) {
-         log_fatal("Failed to render glyph\n");
+   return gm;
+}
+
+void
+release_glyphmap(GlyphMap *gm)
+{
+   for (U32 i = 0; i < gm->face_count; ++i) {
+      if (gm->faces[i]) {
+         FT_Done_Face(gm->faces[i]);
       }
-   
-      FT_GlyphSlot g = face->glyph;
-      FT_Bitmap bm = face->glyph->bitmap;
+   }
+   gm->face_count = 0;
+
+   for (U32 i = 0; i < gm->font_count; ++i) {
+      os_unmap_file(gm->font_files[i]);
+      gm->font_files[i] = null_str8;
+   }
+   gm->font_count = 0;
+}
+
+void
+clear_glyphmap(GlyphMap *gm)
+{
+   MEM_ZERO(gm->data, U64(gm->width) * gm->height);
+   MEM_ZERO(gm->slots, sizeof(gm->slots));
+   MEM_ZERO(gm->buckets, sizeof(gm->buckets));
+
+   gm->slots_used = 1;
+   gm->evictions++;
+   gm->upload_count = 0;
+   gm->upload_all = 1;
+}
 
-      U32 l = g->bitmap_left;
-      S32 t_signed = (S32)(gm.metrics.height - gm.metrics.descender) - g->bitmap_top;
-      t_signed = CLAMP_BOT(t_signed, 0);
-      U32 t = (U32)t_signed;
+void
+save_glyph_cache(GlyphMap *gm)
+{
+   if (!gm->rasterized) {
+      return;
+   }
 
-      U32 tx = i % GM_COUNT_X;
-      U32 ty = i / GM_COUNT_X;
+   TempArena temp = get_scratch();
+
+   U64 slots_size = gm->slots_used * sizeof(GlyphSlot);
+   U64 data_size = U64(gm->width) * gm->height;
+
+   String8 file = {};
+   file.len = sizeof(GlyphCacheHeader) + slots_size + data_size;
+   file.ptr = push_array(temp.arena, U8, file.len);
+
+   GlyphCacheHeader *header = (GlyphCacheHeader *)file.ptr;
+   MEM_ZERO(header, sizeof(GlyphCacheHeader));
+   header->magic = GM_CACHE_MAGIC;
+   header->version = GM_CACHE_VERSION;
+   header->font_hash = gm->font_hash;
+   header->font_size = gm->font_size;
+   header->lcd_filter = GM_LCD_FILTER;
+   header->metrics = gm->metrics;
+   header->width = gm->width;
+   header->height = gm->height;
+   header->slots_used = gm->slots_used;
+
+   MEM_COPY(file.ptr + sizeof(GlyphCacheHeader), gm->slots, slots_size);
+   MEM_COPY(file.ptr + sizeof(GlyphCacheHeader) + slots_size, gm->data, data_size);
+
+   char path[256];
+   glyph_cache_path(gm, path, sizeof(path));
+
+   if (os_write_file(String8(path), file)) {
+      gm->rasterized = 0;
+   } else {
+      log_error("Failed to write glyph cache %s", path);
+   }
 
-      U32 sx = tx * gm.metrics.width * 3 + l * 3;
-      U32 sy = ty * gm.metrics.height + t;
+   release_scratch(temp);
+}
 
-      for (U32 py = 0; py < bm.rows; ++py) {
-         for (U32 px = 0; px < bm.width; px += 3) {
-            U32 row = py * bm.pitch;
-            U8 r = bm.buffer[px + 0 + row];
-            U8 g = bm.buffer[px + 1 + row];
-            U8 b = bm.buffer[px + 2 + row];
+intern NKINLINE void
+glyph_lru_unlink(GlyphMap *gm, U16 slot)
+{
+   GlyphSlot *s = &gm->slots[slot];
+   gm->slots[s->prev].next = s->next;
+   gm->slots[s->next].prev = s->prev;
+}
+
+intern NKINLINE void
+glyph_lru_push_front(GlyphMap *gm, U16 slot)
+{
+   GlyphSlot *s = &gm->slots[slot];
+   s->prev = 0;
+   s->next = gm->slots[0].next;
+   gm->slots[s->next].prev = slot;
+   gm->slots[0].next = slot;
+}
+
+intern void
+glyph_bucket_remove(GlyphMap *gm, U16 slot)
+{
+   U16 *link = &gm->buckets[glyph_bucket(gm->slots[slot].key)];
+   while (*link != slot) {
+      link = &gm->slots[*link].bucket_next;
+   }
+   *link = gm->slots[slot].bucket_next;
+}
+
+// renders the glyph into its slot. Glyphs wider than the cell, like the
+// full width ones of the cjk fallbacks, are scaled down to fit it, what
+// still sticks out is cut off.
+intern void
+rasterize_glyph(GlyphMap *gm, U16 slot, FT_Face face, U32 codepoint)
+{
+   U32 cell_w = gm->metrics.width * 3;
+   U32 cell_h = gm->metrics.height;
+   U32 sx = (slot % GM_COUNT_X) * cell_w;
+   U32 sy = (slot / GM_COUNT_X) * cell_h;
+
+   for (U32 y = 0; y < cell_h; ++y) {
+      MEM_ZERO(gm->data + (sy + y) * gm->width + sx, cell_w);
+   }
+
+   FT_UInt glyph_index = FT_Get_Char_Index(face, codepoint);
+
+   // advances are 16.16 pixels
+   FT_Fixed advance = 0;
+   FT_Fixed cell_advance = (FT_Fixed)gm->metrics.width << 16;
+   B32 scaled = FT_Get_Advance(face, glyph_index, FT_LOAD_TARGET_LCD, &advance) == 0 && advance > cell_advance;
+   if (scaled) {
+      FT_Fixed scale = FT_DivFix(cell_advance, advance);
+      FT_Matrix matrix = {scale, 0, 0, scale};
+      FT_Set_Transform(face, &matrix, 0);
+   }
+
+   B32 rendered = FT_Load_Glyph(face, glyph_index, FT_LOAD_TARGET_LCD) == 0 &&
+                  FT_Render_Glyph(face->glyph, FT_RENDER_MODE_LCD) == 0;
+
+   if (scaled) {
+      FT_Set_Transform(face, 0, 0);
+   }
+
+   if (!rendered) {
+      log_error("Failed to render glyph U+%04X", codepoint);
+      return;
+   }
 
-            U32 x = sx + px;
-            U32 y = sy + py;
+   FT_GlyphSlot g = face->glyph;
+   FT_Bitmap bm = g->bitmap;
 
-            U32 drow = y * gm.width;
-            gm.data[x + 0 + drow] = r;
-            gm.data[x + 1 + drow] = g;
-            gm.data[x + 2 + drow] = b;
+   S32 l = g->bitmap_left * 3;
+   S32 t = (S32)(gm->metrics.height - gm->metrics.descender) - g->bitmap_top;
+
+   for (U32 py = 0; py < bm.rows; ++py) {
+      S32 y = t + (S32)py;
+      if (y < 0 || y >= (S32)cell_h) {
+         continue;
+      }
+
+      U8 *src = bm.buffer + py * bm.pitch;
+      U8 *dst = gm->data + (sy + y) * gm->width + sx;
+
+      for (U32 px = 0; px + 2 < bm.width; px += 3) {
+         S32 x = l + (S32)px;
+         if (x < 0 || x + 3 > (S32)cell_w) {
+            continue;
          }
+
+         dst[x + 0] = src[px + 0];
+         dst[x + 1] = src[px + 1];
+         dst[x + 2] = src[px + 2];
       }
    }
+}
 
-   // stbi_write_jpg("out.jpg", gm.width / 3, gm.height, 3, gm.data, 100);
+intern U32
+glyph_face(GlyphMap *gm, U32 codepoint)
+{
+   // picking the face needs the fallbacks open
+   if (!gm->face_count && codepoint >= 128 && gm->font_count > 1) {
+      load_glyph_faces(gm);
+   }
 
-   return gm;
+   // the first face that has the glyph draws it, the first one draws
+   // its missing glyph box otherwise
+   U32 face = 0;
+   if (codepoint >= 128 && gm->face_count > 1) {
+      for (U32 i = 0; i < gm->face_count; ++i) {
+         if (gm->faces[i] && FT_Get_Char_Index(gm->faces[i], codepoint)) {
+            face = i;
+            break;
+         }
+      }
+   }
+
+   return face;
+}
+
+// finds the slot of the key or takes one for it, returns 1 when the glyph
+// still has to be rasterized into the slot
+intern B32
+glyph_assign_slot(GlyphMap *gm, U32 key, U16 *slot_out)
+{
+   U16 slot = gm->buckets[glyph_bucket(key)];
+   while (slot && gm->slots[slot].key != key) {
+      slot = gm->slots[slot].bucket_next;
+   }
+
+   if (slot) {
+      glyph_lru_unlink(gm, slot);
+      glyph_lru_push_front(gm, slot);
+      *slot_out = slot;
+      return 0;
+   }
+
+   if (gm->slots_used < GM_SLOT_COUNT) {
+      slot = (U16)gm->slots_used++;
+   } else {
+      slot = gm->slots[0].prev;
+      glyph_lru_unlink(gm, slot);
+      glyph_bucket_remove(gm, slot);
+      gm->evictions++;
+   }
+
+   GlyphSlot *s = &gm->slots[slot];
+   s->key = key;
+   s->bucket_next = gm->buckets[glyph_bucket(key)];
+   gm->buckets[glyph_bucket(key)] = slot;
+   glyph_lru_push_front(gm, slot);
+
+   *slot_out = slot;
+   return 1;
+}
+
+intern void
+glyph_queue_upload(GlyphMap *gm, U16 slot)
+{
+   if (gm->upload_count < GM_MAX_UPLOADS) {
+      gm->uploads[gm->upload_count++] = slot;
+   } else {
+      gm->upload_all = 1;
+   }
 }
 
 U32
 load_glyph(GlyphMap *gm, U32 codepoint)
 {
-   if_likely(codepoint < 128) {
-      codepoint -= GM_ASCII_START;
-      U32 x = codepoint % GM_COUNT_X;
-      U32 y = codepoint / GM_COUNT_X;
-      return (x << 16) | y;
+   if (codepoint == ' ') {
+      return 0;
+   }
+
+   U32 face = glyph_face(gm, codepoint);
+   U32 key = (face << 24) | (codepoint & 0xFFFFFF);
+
+   U16 slot;
+   if (glyph_assign_slot(gm, key, &slot)) {
+      if (!gm->face_count) {
+         load_glyph_faces(gm);
+      }
+
+      rasterize_glyph(gm, slot, gm->faces[face], codepoint);
+      gm->rasterized++;
+
+      glyph_queue_upload(gm, slot);
+   }
+
+   return slot;
+}
+
+// every worker takes every n-th job, the caller is worker 0
+intern void
+glyph_run_jobs(GlyphMap *gm, GlyphJob *jobs, U32 job_count, U32 index, U32 worker_count, FT_Face face)
+{
+   for (U32 i = index; i < job_count; i += worker_count) {
+      // only the caller has the fallback faces
+      if (jobs[i].face == 0) {
+         rasterize_glyph(gm, jobs[i].slot, face, jobs[i].codepoint);
+      }
+   }
+}
+
+intern void
+glyph_worker_main(void *param)
+{
+   GlyphWorker *w = (GlyphWorker *)param;
+   GlyphPool *pool = w->pool;
+
+   U64 seen = 0;
+
+   for (;;) {
+      os_mutex_lock(pool->mutex);
+      while (pool->generation == seen && !pool->quit) {
+         os_condvar_wait(pool->start, pool->mutex);
+      }
+
+      if (pool->quit) {
+         os_mutex_unlock(pool->mutex);
+         break;
+      }
+
+      seen = pool->generation;
+      os_mutex_unlock(pool->mutex);
+
+      glyph_run_jobs(pool->gm, pool->jobs, pool->job_count, w->index, pool->thread_count + 1, w->face);
+
+      os_mutex_lock(pool->mutex);
+      if (--pool->running == 0) {
+         os_condvar_signal(pool->done);
+      }
+      os_mutex_unlock(pool->mutex);
+   }
+}
+
+GlyphPool *
+create_glyph_pool(GlyphMap *gm, U32 thread_count)
+{
+   GlyphPool *pool = (GlyphPool *)malloc(sizeof(GlyphPool));
+   MEM_ZERO(pool, sizeof(GlyphPool));
+
+   pool->mutex = os_mutex_alloc();
+   pool->start = os_condvar_alloc();
+   pool->done = os_condvar_alloc();
+   pool->font_size = gm->font_size;
+
+   thread_count = MIN(thread_count, (U32)GM_MAX_THREADS);
+
+   for (U32 i = 0; i < thread_count; ++i) {
+      GlyphWorker *w = &pool->workers[i];
+      w->pool = pool;
+      w->index = i + 1;
+
+      // faces are opened here, the library is not safe to open them from several threads
+      if (FT_New_Memory_Face(gm->freetype, gm->font_files[0].ptr, (FT_Long)gm->font_files[0].len, 0, &w->face) != 0 ||
+          FT_Set_Pixel_Sizes(w->face, 0, pool->font_size) != 0) {
+         log_error("Failed to load face for glyph worker");
+         break;
+      }
+
+      pool->threads[i] = os_thread_start(glyph_worker_main, w);
+      if (!pool->threads[i]) {
+         FT_Done_Face(w->face);
+         break;
+      }
+
+      pool->thread_count++;
+   }
+
+   return pool;
+}
+
+void
+destroy_glyph_pool(GlyphPool *pool)
+{
+   os_mutex_lock(pool->mutex);
+   pool->quit = 1;
+   os_condvar_broadcast(pool->start);
+   os_mutex_unlock(pool->mutex);
+
+   for (U32 i = 0; i < pool->thread_count; ++i) {
+      os_thread_join(pool->threads[i]);
+      FT_Done_Face(pool->workers[i].face);
+   }
+
+   os_condvar_release(pool->start);
+   os_condvar_release(pool->done);
+   os_mutex_release(pool->mutex);
+   free(pool);
+}
+
+void
+load_glyphs(GlyphMap *gm, GlyphPool *pool, U32 *codepoints, U32 count, U32 *slots)
+{
+   // a slot taken twice in the batch only keeps its last glyph
+   GlyphJob jobs[GM_SLOT_COUNT];
+   U16 job_of_slot[GM_SLOT_COUNT];
+   MEM_SET(job_of_slot, 0xFF, sizeof(job_of_slot));
+   U32 job_count = 0;
+
+   for (U32 i = 0; i < count; ++i) {
+      U32 codepoint = codepoints[i];
+      if (codepoint == ' ') {
+         slots[i] = 0;
+         continue;
+      }
+
+      U32 face = glyph_face(gm, codepoint);
+      U32 key = (face << 24) | (codepoint & 0xFFFFFF);
+
+      U16 slot;
+      if (glyph_assign_slot(gm, key, &slot)) {
+         if (job_of_slot[slot] == 0xFFFF) {
+            job_of_slot[slot] = (U16)job_count++;
+         }
+         jobs[job_of_slot[slot]] = {slot, (U16)face, codepoint};
+      }
+
+      slots[i] = slot;
+   }
+
+   if (!job_count) {
+      return;
+   }
+
+   if (!gm->face_count) {
+      load_glyph_faces(gm);
+   }
+
+   if (pool && pool->thread_count && job_count > 1) {
+      os_mutex_lock(pool->mutex);
+
+      if (pool->font_size != gm->font_size) {
+         for (U32 i = 0; i < pool->thread_count; ++i) {
+            FT_Set_Pixel_Sizes(pool->workers[i].face, 0, gm->font_size);
+         }
+         pool->font_size = gm->font_size;
+      }
+
+      pool->gm = gm;
+      pool->jobs = jobs;
+      pool->job_count = job_count;
+      pool->running = pool->thread_count;
+      pool->generation++;
+      os_condvar_broadcast(pool->start);
+      os_mutex_unlock(pool->mutex);
+
+      glyph_run_jobs(gm, jobs, job_count, 0, pool->thread_count + 1, gm->faces[0]);
+
+      os_mutex_lock(pool->mutex);
+      while (pool->running) {
+         os_condvar_wait(pool->done, pool->mutex);
+      }
+      os_mutex_unlock(pool->mutex);
+   } else {
+      glyph_run_jobs(gm, jobs, job_count, 0, 1, gm->faces[0]);
+   }
+
+   for (U32 i = 0; i < job_count; ++i) {
+      if (jobs[i].face != 0) {
+         rasterize_glyph(gm, jobs[i].slot, gm->faces[jobs[i].face], jobs[i].codepoint);
+      }
+
+      glyph_queue_upload(gm, jobs[i].slot);
+   }
+
+   gm->rasterized += job_count;
+}
+
+void
+init_glyph_atlas_set(GlyphAtlasSet *set, Arena *arena, const char *font_name, U32 font_size, FT_Library freetype)
+{
+   MEM_ZERO(set, sizeof(GlyphAtlasSet));
+   set->font_name = font_name;
+
+   for (U32 i = 0; i < GM_ZOOM_LEVELS; ++i) {
+      sub_arena(&set->arenas[i], arena, GM_LEVEL_ARENA_SIZE);
+      arena_set_name(&set->arenas[i], "glyph atlas");
+   }
+
+   U32 level = 0;
+   while (level + 1 < GM_ZOOM_LEVELS && gm_zoom_sizes[level] < font_size) {
+      level++;
+   }
+
+   set->maps[level] = load_glyphmap(&set->arenas[level], font_name, gm_zoom_sizes[level], freetype);
+   set->states[level] = ATLAS_READY;
+   set->level = level;
+   set->wanted = level;
+}
+
+intern void
+glyph_atlas_builder_main(void *param)
+{
+   GlyphAtlasSet *set = (GlyphAtlasSet *)param;
+
+   for (;;) {
+      os_mutex_lock(set->mutex);
+
+      // the level a zoom waits for goes first, then the closest to the current one
+      U32 level = GM_ZOOM_LEVELS;
+      for (;;) {
+         if (set->quit) {
+            break;
+         }
+
+         if (set->states[set->wanted] == ATLAS_QUEUED) {
+            level = set->wanted;
+         } else {
+            for (U32 d = 1; d < GM_ZOOM_LEVELS && level == GM_ZOOM_LEVELS; ++d) {
+               if (set->level >= d && set->states[set->level - d] == ATLAS_QUEUED) {
+                  level = set->level - d;
+               } else if (set->level + d < GM_ZOOM_LEVELS && set->states[set->level + d] == ATLAS_QUEUED) {
+                  level = set->level + d;
+               }
+            }
+         }
+
+         if (level < GM_ZOOM_LEVELS) {
+            break;
+         }
+
+         os_condvar_wait(set->cond, set->mutex);
+      }
+
+      if (set->quit) {
+         os_mutex_unlock(set->mutex);
+         break;
+      }
+
+      atomic_store_u32(&set->states[level], ATLAS_BUILDING);
+      TempArena scratch = get_scratch();
+      U32 prewarm_count = set->prewarm_count;
+      U32 *prewarm = push_array(scratch.arena, U32, prewarm_count);
+      U32 *slots = push_array(scratch.arena, U32, prewarm_count);
+      MEM_COPY(prewarm, set->prewarm, prewarm_count * sizeof(U32));
+      os_mutex_unlock(set->mutex);
+
+      GlyphMap *gm = &set->maps[level];
+      *gm = load_glyphmap(&set->arenas[level], set->font_name, gm_zoom_sizes[level], set->freetype);
+      load_glyphs(gm, set->pool, prewarm, prewarm_count, slots);
+      release_scratch(scratch);
+
+      // the ui thread never opens faces with the library of the builder
+      if (!gm->face_count) {
+         load_glyph_faces(gm);
+      }
+
+      atomic_store_u32(&set->states[level], ATLAS_READY);
+
+      if (set->wake) {
+         set->wake();
+      }
    }
 
-   return '?' - GM_ASCII_START;
+   free_thread_scratch();
+}
+
+void
+request_glyph_atlas(GlyphAtlasSet *set, U32 level)
+{
+   if (!set->thread || level >= GM_ZOOM_LEVELS || atomic_load_u32(&set->states[level]) != ATLAS_EMPTY) {
+      return;
+   }
+
+   GlyphMap *current = &set->maps[set->level];
+
+   os_mutex_lock(set->mutex);
+
+   // oldest first, so the new atlas keeps the recently used ones in front
+   set->prewarm_count = 0;
+   for (U16 slot = current->slots[0].prev; slot; slot = current->slots[slot].prev) {
+      set->prewarm[set->prewarm_count++] = current->slots[slot].key & 0xFFFFFF;
+   }
+
+   set->states[level] = ATLAS_QUEUED;
+   os_condvar_signal(set->cond);
+   os_mutex_unlock(set->mutex);
+}
+
+// the next zoom in either direction is ready by the time it comes
+intern void
+request_adjacent_atlases(GlyphAtlasSet *set)
+{
+   if (set->level > 0) {
+      request_glyph_atlas(set, set->level - 1);
+   }
+   request_glyph_atlas(set, set->level + 1);
+}
+
+void
+zoom_glyph_atlas(GlyphAtlasSet *set, S32 delta)
+{
+   S32 level = CLAMP(0, (S32)set->wanted + delta, GM_ZOOM_LEVELS - 1);
+
+   if (set->thread) {
+      os_mutex_lock(set->mutex);
+      set->wanted = (U32)level;
+      os_mutex_unlock(set->mutex);
+   }
+
+   request_glyph_atlas(set, (U32)level);
+}
+
+B32
+switch_glyph_atlas(GlyphAtlasSet *set)
+{
+   if (set->wanted == set->level || atomic_load_u32(&set->states[set->wanted]) != ATLAS_READY) {
+      return 0;
+   }
+
+   os_mutex_lock(set->mutex);
+   set->level = set->wanted;
+   os_mutex_unlock(set->mutex);
+
+   request_adjacent_atlases(set);
+
+   return 1;
+}
+
+void
+start_glyph_atlas_builder(GlyphAtlasSet *set, GlyphPool *pool, GlyphWakeFunc *wake)
+{
+   set->pool = pool;
+   set->wake = wake;
+   set->freetype = init_freetype();
+   set->mutex = os_mutex_alloc();
+   set->cond = os_condvar_alloc();
+
+   set->thread = os_thread_start(glyph_atlas_builder_main, set);
+   if (!set->thread) {
+      log_error("Failed to start the glyph atlas builder");
+      return;
+   }
+
+   request_adjacent_atlases(set);
+}
+
+void
+destroy_glyph_atlas_set(GlyphAtlasSet *set)
+{
+   if (set->thread) {
+      os_mutex_lock(set->mutex);
+      set->quit = 1;
+      os_condvar_signal(set->cond);
+      os_mutex_unlock(set->mutex);
+
+      os_thread_join(set->thread);
+   }
+
+   // the faces of the pool were opened from the font of a level
+   if (set->pool) {
+      destroy_glyph_pool(set->pool);
+   }
+
+   for (U32 i = 0; i < GM_ZOOM_LEVELS; ++i) {
+      if (set->states[i] == ATLAS_READY) {
+         save_glyph_cache(&set->maps[i]);
+         release_glyphmap(&set->maps[i]);
+      }
+   }
+
+   if (set->mutex) {
+      os_condvar_release(set->cond);
+      os_mutex_release(set->mutex);
+      release_freetype(set->freetype);
+   }
 }
@@ -1,5 +1,21 @@
 #pragma once
 
+enum
+{
+   GM_COUNT_X = 64,
+   GM_COUNT_Y = 32,
+   GM_SLOT_COUNT = GM_COUNT_X * GM_COUNT_Y, // slot indices fit the 16 bits of a cell
+   GM_BUCKET_COUNT = 1024,
+   GM_MAX_FACES = 4, // the font and its fallbacks
+   GM_MAX_UPLOADS = 256, // new glyphs per frame before the whole atlas is uploaded
+   GM_MAX_THREADS = 16,
+   GM_ZOOM_LEVELS = 9,
+   GM_LEVEL_ARENA_SIZE = MEGA_BYTES(8), // atlas of the largest size
+   GM_LCD_FILTER = FT_LCD_FILTER_DEFAULT,
+   GM_CACHE_MAGIC = 0x48504C47, // "GLPH"
+   GM_CACHE_VERSION = 2,
+};
+
 struct GlyphMetrics
 {
    U32 width;
@@ -7,16 +23,173 @@ struct GlyphMetrics
    U32 descender;
 };
 
-struct GlyphMap
+struct GlyphSlot
+{
+   U32 key; // face << 24 | codepoint
+   U16 prev; // lru list, slot 0 is its sentinel
+   U16 next;
+   U16 bucket_next;
+};
+
+// Header of the atlas cache file, followed by the used slots and the atlas
+// itself. A cache only holds for the font, size and filter it was made with.
+struct GlyphCacheHeader
 {
-   U8 *data;
+   U32 magic;
+   U32 version;
+   U64 font_hash;
+   U32 font_size;
+   U32 lcd_filter;
+   GlyphMetrics metrics;
    U32 width;
    U32 height;
+   U32 slots_used;
+};
+
+// Atlas of the glyphs in use. Glyphs are rasterized the first time they
+// are asked for, when all slots are taken the least recently used one is
+// reused. Slot 0 stays blank, zeroed cells show nothing.
+struct GlyphMap
+{
+   U8 *data; // 3 bytes per pixel for the lcd subpixels
+   U32 width; // in bytes
+   U32 height;
    GlyphMetrics metrics;
+
+   // searched in order for a codepoint. With a cached atlas the faces
+   // are only opened once a glyph is missing from it.
+   FT_Face faces[GM_MAX_FACES]; // 0 for a fallback that failed to open
+   U32 face_count;
+   FT_Library freetype;
+   String8 font_files[GM_MAX_FACES]; // mapped, the faces read from them
+   U32 font_count; // the font and the fallbacks that were found
+   U64 font_hash;
+   U32 font_size;
+   B32 cache_hit;
+   U64 rasterized; // glyphs the cache file does not have yet
+
+   GlyphSlot slots[GM_SLOT_COUNT];
+   U16 buckets[GM_BUCKET_COUNT];
+   U32 slots_used;
+   U64 evictions; // cells that still show an evicted slot need a new render
+
+   // slots rasterized since the texture was last updated
+   U16 uploads[GM_MAX_UPLOADS];
+   U32 upload_count;
+   B32 upload_all;
+};
+
+struct GlyphJob
+{
+   U16 slot;
+   U16 face;
+   U32 codepoint;
+};
+
+struct GlyphPool;
+
+struct GlyphWorker
+{
+   GlyphPool *pool;
+   U32 index;
+   FT_Face face; // faces are not thread safe, every worker has its own
 };
 
+// Threads that rasterize a batch of glyphs together with the caller. The
+// slots are handed out before the batch starts, so every job writes its own
+// part of the atlas and the result is the same as rasterizing one by one.
+struct GlyphPool
+{
+   GlyphWorker workers[GM_MAX_THREADS];
+   OS_Handle threads[GM_MAX_THREADS];
+   U32 thread_count;
+   U32 font_size; // the worker faces are set to
+
+   OS_Handle mutex;
+   OS_Handle start;
+   OS_Handle done;
+   U64 generation;
+   U32 running;
+   B32 quit;
+
+   GlyphMap *gm;
+   GlyphJob *jobs;
+   U32 job_count;
+};
+
+enum
+{
+   ATLAS_EMPTY = 0,
+   ATLAS_QUEUED,
+   ATLAS_BUILDING,
+   ATLAS_READY,
+};
+
+global const U32 gm_zoom_sizes[GM_ZOOM_LEVELS] = {10, 12, 14, 16, 18, 20, 24, 28, 32};
+
+typedef void GlyphWakeFunc(void);
+
+// An atlas per zoom level. The ones next to the level in use are built on
+// a background thread ahead of time, a zoom only switches to an atlas once
+// it is ready so no frame waits for rasterization. Only the ui thread
+// touches the atlas of the current level.
+struct GlyphAtlasSet
+{
+   GlyphMap maps[GM_ZOOM_LEVELS];
+   Arena arenas[GM_ZOOM_LEVELS];
+   U32 states[GM_ZOOM_LEVELS]; // read without the lock
+   U32 level;
+   U32 wanted; // switched to once it is ready
+
+   const char *font_name;
+   GlyphPool *pool; // owned by the builder once it runs
+   FT_Library freetype; // of the builder, a library opens faces on one thread at a time
+   GlyphWakeFunc *wake;
+
+   OS_Handle thread;
+   OS_Handle mutex;
+   OS_Handle cond;
+   B32 quit;
+
+   // glyphs in use when the last level was queued, new atlases start with them
+   U32 prewarm[GM_SLOT_COUNT];
+   U32 prewarm_count;
+};
+
+// fonts searched for the glyphs the font lacks, in the order they are
+// added and before the ones of the platform. Missing files are skipped.
+intern void add_glyph_fallback_font(const char *path);
+
 intern FT_Library init_freetype();
 intern void release_freetype(FT_Library lib);
 intern GlyphMap load_glyphmap(Arena *arena, const char *font_name, U32 font_size, FT_Library freetype);
+intern void release_glyphmap(GlyphMap *gm);
 
+// forgets every glyph, cells that show one need a new render
+intern void clear_glyphmap(GlyphMap *gm);
+
+// writes the atlas to the cache file when glyphs were added to it
+intern void save_glyph_cache(GlyphMap *gm);
+
+// slot of the glyph, slots are laid out row by row GM_COUNT_X wide
 intern U32 load_glyph(GlyphMap *gm, U32 codepoint);
+
+// same as calling load_glyph for each codepoint in order, the missing
+// glyphs are rasterized on the pool when one is given
+intern void load_glyphs(GlyphMap *gm, GlyphPool *pool, U32 *codepoints, U32 count, U32 *slots);
+
+// thread_count threads besides the caller, the faces are opened from the font of gm
+intern GlyphPool *create_glyph_pool(GlyphMap *gm, U32 thread_count);
+intern void destroy_glyph_pool(GlyphPool *pool);
+
+// the level of font_size is loaded right away, the builder starts on the first request
+intern void init_glyph_atlas_set(GlyphAtlasSet *set, Arena *arena, const char *font_name, U32 font_size, FT_Library freetype);
+intern void start_glyph_atlas_builder(GlyphAtlasSet *set, GlyphPool *pool, GlyphWakeFunc *wake);
+// ui thread: builds the level in the background unless it is there already
+intern void request_glyph_atlas(GlyphAtlasSet *set, U32 level);
+// ui thread: asks for the level delta steps from the wanted one
+intern void zoom_glyph_atlas(GlyphAtlasSet *set, S32 delta);
+// ui thread: moves to the wanted level if its atlas is ready, returns 1 when it did
+intern B32 switch_glyph_atlas(GlyphAtlasSet *set);
+// saves the caches of every built level
+intern void destroy_glyph_atlas_set(GlyphAtlasSet *set);
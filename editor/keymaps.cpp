@@ -30,7 +30,7 @@ SHORTCUT(insert_char)
    InputEvent input_event = ed->last_input_event;
 
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    U8 ch       = input_event.ch;
 
@@ -75,7 +75,7 @@ SHORTCUT(cursor_right)
 SHORTCUT(cursor_up)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
    
    if (p->cursor_store < 0) {
       p->cursor_store = (S64) cursor_column(buf, p->cursor);
@@ -90,7 +90,7 @@ SHORTCUT(cursor_up)
 SHORTCUT(cursor_down)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    if (p->cursor_store < 0) {
       p->cursor_store = (S64) cursor_column(buf, p->cursor);
@@ -105,7 +105,7 @@ SHORTCUT(cursor_down)
 SHORTCUT(delete_forwards)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    U64 before = p->cursor;
    pane_set_cursor(p, delete_char(buf, p->cursor));
@@ -115,7 +115,7 @@ SHORTCUT(delete_forwards)
 SHORTCUT(delete_backwards)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    if (p->cursor == 0) {
       return;
@@ -131,7 +131,7 @@ SHORTCUT(delete_backwards)
 SHORTCUT(insert_new_line)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    U64 before = p->cursor;
    pane_set_cursor(p, insert_line(&p->buffer, p->cursor, 1));
@@ -141,7 +141,7 @@ SHORTCUT(insert_new_line)
 SHORTCUT(insert_tab)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    U64 before = p->cursor;
    pane_set_cursor(p, insert_char(buf, '\t', p->cursor));
@@ -151,7 +151,7 @@ SHORTCUT(insert_tab)
 SHORTCUT(normal_mode)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    ed->mode = ED_NORMAL;
    g_normal_index                  = 0;
@@ -161,7 +161,7 @@ SHORTCUT(normal_mode)
 SHORTCUT(normal_cursor_back)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    pane_set_cursor(p, cursor_back_normal(buf, p->cursor));
 }
@@ -169,7 +169,7 @@ SHORTCUT(normal_cursor_back)
 SHORTCUT(normal_cursor_next)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    pane_set_cursor(p, cursor_next_normal(buf, p->cursor));
 }
@@ -177,7 +177,7 @@ SHORTCUT(normal_cursor_next)
 SHORTCUT(insert_beginning_of_line)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    pane_set_cursor(p, cursor_line_begin(buf, p->cursor));
    ed->mode = ED_INSERT;
@@ -186,7 +186,7 @@ SHORTCUT(insert_beginning_of_line)
 SHORTCUT(insert_end_of_line)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    U64 end = cursor_line_end(buf, p->cursor);
    pane_set_cursor(p, end);
@@ -201,7 +201,7 @@ SHORTCUT(insert_mode)
 SHORTCUT(insert_mode_next)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    ed->mode = ED_INSERT;
    pane_cursor_next(p);
@@ -210,7 +210,7 @@ SHORTCUT(insert_mode_next)
 SHORTCUT(go_word_next)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    pane_set_cursor(p, cursor_next_word(buf, p->cursor));
 }
@@ -218,7 +218,7 @@ SHORTCUT(go_word_next)
 SHORTCUT(go_word_end)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    pane_set_cursor(p, cursor_end_of_word(buf, p->cursor));
 }
@@ -226,7 +226,7 @@ SHORTCUT(go_word_end)
 SHORTCUT(go_word_prev)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    pane_set_cursor(p, cursor_prev_word(buf, p->cursor));
 }
@@ -234,7 +234,7 @@ SHORTCUT(go_word_prev)
 SHORTCUT(goto_buffer_begin)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    pane_set_cursor(p, 0);
 }
@@ -242,7 +242,7 @@ SHORTCUT(goto_buffer_begin)
 SHORTCUT(goto_buffer_end)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    pane_set_cursor(p, buf->len);
 }
@@ -250,7 +250,7 @@ SHORTCUT(goto_buffer_end)
 SHORTCUT(new_line_before)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    U64 before = p->cursor;
    p->cursor = cursor_prev_line_end(buf, p->cursor);
@@ -262,7 +262,7 @@ SHORTCUT(new_line_before)
 SHORTCUT(new_line_after)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    U64 before = p->cursor;
    p->cursor = cursor_line_end(buf, p->cursor);
@@ -274,7 +274,7 @@ SHORTCUT(new_line_after)
 SHORTCUT(skip_paragraph_up)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    pane_set_cursor(p, cursor_paragraph_up(buf, p->cursor));
 }
@@ -282,7 +282,7 @@ SHORTCUT(skip_paragraph_up)
 SHORTCUT(skip_paragraph_down)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    pane_set_cursor(p, cursor_paragraph_down(buf, p->cursor));
 }
@@ -328,7 +328,7 @@ SHORTCUT(normal_handle)
 SHORTCUT(visual_mode)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    ed->mode = ED_VISUAL;
 
@@ -338,7 +338,7 @@ SHORTCUT(visual_mode)
 SHORTCUT(visual_mode_line)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    ed->mode = ED_VISUAL_LINE;
 }
@@ -346,7 +346,7 @@ SHORTCUT(visual_mode_line)
 SHORTCUT(visual_line_down)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 
    shortcut_fn_cursor_down(ed);
 }
@@ -354,43 +354,43 @@ SHORTCUT(visual_line_down)
 SHORTCUT(visual_line_up)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 }
 
 SHORTCUT(visual_line_buffer_begin)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 }
 
 SHORTCUT(visual_line_buffer_end)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 }
 
 SHORTCUT(visual_delete)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 }
 
 SHORTCUT(visual_yoink)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 }
 
 SHORTCUT(yoink_selection)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 }
 
 SHORTCUT(yoink_paste)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
 }
 
 /* TODO: definetly rework this! */
@@ -398,7 +398,7 @@ B32
 normal_mode_get_shortcut(Editor *ed, Shortcut *shortcut)
 {
    Pane *p = &ed->pane;
-   GapBuffer *buf = &p->buffer;
+   TextBuffer *buf = &p->buffer;
    U8     *normal_buffer = g_normal_buffer;
 
    switch (normal_buffer[0]) {
@@ -0,0 +1,389 @@
+#include "parse_worker.h"
+
+#include "buffer.h"
+
+global ParseWakeFunc *parse_worker_wake;
+
+// makes room for size bytes, the old contents are gone
+intern void
+parse_snapshot_reserve(ParseSnapshot *s, U64 size)
+{
+   if (s->arena.size < size) {
+      if (s->arena.ptr) {
+         free_arena(&s->arena, s->arena.size);
+      }
+      init_arena(&s->arena, ALIGN_POW2(size * 2, MEGA_BYTES(1)));
+      arena_set_name(&s->arena, "parse snapshot");
+   }
+
+   s->arena.top = 0;
+}
+
+void
+parse_snapshot_gap(ParseSnapshot *s, GapBuffer *gb, U64 base_len, B32 merge)
+{
+   U64 keep_before, keep_after;
+   gap_buffer_take_edited(gb, &keep_before, &keep_after);
+
+   if (merge && s->patch) {
+      keep_before = MIN(keep_before, s->keep_before);
+      keep_after = MIN(keep_after, s->keep_after);
+      base_len = s->base_len;
+   }
+
+   // both ends have to be in the copy of the worker as well as in the text
+   U64 limit = MIN(base_len, gb->len);
+   keep_before = MIN(keep_before, limit);
+   keep_after = MIN(keep_after, limit - keep_before);
+
+   U64 middle_len = gb->len - keep_before - keep_after;
+   parse_snapshot_reserve(s, middle_len + sizeof(U64) + 64);
+
+   s->starts = push_array(&s->arena, U64, 1);
+   s->starts[0] = 0;
+   s->pieces = 0;
+   s->piece_count = 1;
+
+   s->patch = 1;
+   s->base_len = base_len;
+   s->keep_before = keep_before;
+   s->keep_after = keep_after;
+   s->middle.ptr = push_array(&s->arena, U8, middle_len);
+   s->middle.len = middle_len;
+
+   for (U64 pos = keep_before; pos < keep_before + middle_len;) {
+      String8 chunk = gap_buffer_chunk_at(gb, pos);
+      U64 n = MIN(chunk.len, keep_before + middle_len - pos);
+      MEM_COPY(s->middle.ptr + (pos - keep_before), chunk.ptr, n);
+      pos += n;
+   }
+}
+
+void
+parse_snapshot_pieces(ParseSnapshot *s, PieceTree *pt)
+{
+   U64 capacity = pt->nodes.live_count + 1;
+   parse_snapshot_reserve(s, capacity * (sizeof(String8) + sizeof(U64)) + 64);
+
+   s->pieces = push_array(&s->arena, String8, capacity);
+   s->starts = push_array(&s->arena, U64, capacity);
+   s->piece_count = piece_tree_pieces(pt, s->pieces);
+   s->patch = 0;
+
+   U64 start = 0;
+   for (U64 i = 0; i < s->piece_count; ++i) {
+      s->starts[i] = start;
+      start += s->pieces[i].len;
+   }
+}
+
+ParseText
+parse_snapshot_text(ParseSnapshot *s, Arena *text_arena, String8 *text)
+{
+   ParseText t = {};
+   t.starts = s->starts;
+   t.piece_count = s->piece_count;
+
+   if (!s->patch) {
+      t.pieces = s->pieces;
+      return t;
+   }
+
+   if (!text_arena->ptr) {
+      init_arena(text_arena, PARSE_MAX_TEXT);
+      arena_set_name(text_arena, "parse text");
+      text->ptr = text_arena->ptr;
+      text->len = 0;
+   }
+
+   ASSERT(text->len == s->base_len);
+
+   U64 len = s->keep_before + s->middle.len + s->keep_after;
+   if (len > text_arena->top) {
+      push_size(text_arena, len - text_arena->top, 1);
+   }
+
+   MEM_MOVE(text->ptr + s->keep_before + s->middle.len, text->ptr + text->len - s->keep_after, s->keep_after);
+   MEM_COPY(text->ptr + s->keep_before, s->middle.ptr, s->middle.len);
+   text->len = len;
+
+   t.pieces = text;
+   return t;
+}
+
+const char *
+parse_text_read(void *payload, U32 byte_index, TSPoint position, U32 *bytes_read)
+{
+   ParseText *t = (ParseText *) payload;
+
+   U64 i = t->last;
+   if (i + 1 < t->piece_count && byte_index >= t->starts[i + 1]) {
+      i++;
+   }
+
+   if (i >= t->piece_count || byte_index < t->starts[i] ||
+       (i + 1 < t->piece_count && byte_index >= t->starts[i + 1])) {
+      // the last piece that starts at or before the index
+      U64 lo = 0;
+      U64 hi = t->piece_count;
+      while (hi - lo > 1) {
+         U64 mid = (lo + hi) / 2;
+         if (t->starts[mid] <= byte_index) {
+            lo = mid;
+         } else {
+            hi = mid;
+         }
+      }
+      i = lo;
+   }
+
+   if (i >= t->piece_count || byte_index >= t->starts[i] + t->pieces[i].len) {
+      *bytes_read = 0;
+      return "";
+   }
+
+   t->last = i;
+
+   U64 offset = byte_index - t->starts[i];
+   *bytes_read = (U32) MIN(t->pieces[i].len - offset, (U64)max_U32);
+
+   return (const char *) t->pieces[i].ptr + offset;
+}
+
+intern void
+parse_worker_main(void *param)
+{
+   ParseWorker *w = (ParseWorker *) param;
+
+   for (;;) {
+      os_mutex_lock(w->mutex);
+      while (!w->has_job && !w->quit) {
+         os_condvar_wait(w->cond, w->mutex);
+      }
+
+      if (w->quit) {
+         os_mutex_unlock(w->mutex);
+         break;
+      }
+
+      ParseSnapshot *snapshot = &w->snapshots[w->next_snapshot];
+      w->next_snapshot ^= 1;
+
+      if (w->edits_overflow || w->base_edit_count + w->edit_count > PARSE_MAX_EDITS) {
+         w->base_stale = 1;
+         w->base_edit_count = 0;
+      } else {
+         MEM_COPY(w->base_edits + w->base_edit_count, w->edits, w->edit_count * sizeof(TSInputEdit));
+         w->base_edit_count += w->edit_count;
+      }
+
+      U64 generation = w->job_generation;
+      w->edit_count = 0;
+      w->edits_overflow = 0;
+      w->has_job = 0;
+
+      // a flag raised for an older snapshot does not concern this one
+      atomic_store_u64(&w->cancel, 0);
+      os_mutex_unlock(w->mutex);
+
+      TSTree *old_tree = 0;
+      if (w->base && !w->base_stale) {
+         old_tree = ts_tree_copy(w->base);
+         for (U32 i = 0; i < w->base_edit_count; ++i) {
+            ts_tree_edit(old_tree, &w->base_edits[i]);
+         }
+      }
+
+      ParseText text = parse_snapshot_text(snapshot, &w->text_arena, &w->text);
+
+      TSInput input = {};
+      input.payload = &text;
+      input.read = parse_text_read;
+      input.encoding = TSInputEncodingUTF8;
+
+      TSTree *tree = ts_parser_parse(w->parser, old_tree, input);
+
+      if (old_tree) {
+         ts_tree_delete(old_tree);
+      }
+
+      // cancelled, the edits stay around for the next snapshot
+      if (!tree) {
+         ts_parser_reset(w->parser);
+         continue;
+      }
+
+      if (w->base) {
+         ts_tree_delete(w->base);
+      }
+      w->base = tree;
+      w->base_edit_count = 0;
+      w->base_stale = 0;
+
+      ParseResult *result = (ParseResult *) malloc(sizeof(ParseResult));
+      result->tree = ts_tree_copy(tree);
+      result->generation = generation;
+
+      ParseResult *unused = (ParseResult *) atomic_exchange_ptr(&w->published, result);
+      if (unused) {
+         ts_tree_delete(unused->tree);
+         free(unused);
+      }
+
+      if (parse_worker_wake) {
+         parse_worker_wake();
+      }
+   }
+}
+
+void
+parse_worker_set_wake(ParseWakeFunc *wake)
+{
+   parse_worker_wake = wake;
+}
+
+ParseWorker *
+parse_worker_start(const TSLanguage *lang)
+{
+   Arena arena = {};
+   init_arena(&arena, sizeof(ParseWorker) + 64);
+   arena_set_name(&arena, "parse worker");
+
+   ParseWorker *w = push_struct(&arena, ParseWorker, 8);
+   MEM_ZERO(w, sizeof(ParseWorker));
+   w->arena = arena;
+
+   w->parser = ts_parser_new();
+   ts_parser_set_language(w->parser, lang);
+   ts_parser_set_cancellation_flag(w->parser, (const size_t *) &w->cancel);
+
+   w->mutex = os_mutex_alloc();
+   w->cond = os_condvar_alloc();
+   w->thread = os_thread_start(parse_worker_main, w);
+
+   if (!w->thread) {
+      log_error("failed to start the parse worker");
+   }
+
+   return w;
+}
+
+void
+parse_worker_stop(ParseWorker *w)
+{
+   os_mutex_lock(w->mutex);
+   w->quit = 1;
+   os_condvar_signal(w->cond);
+   os_mutex_unlock(w->mutex);
+
+   atomic_store_u64(&w->cancel, 1);
+
+   if (w->thread) {
+      os_thread_join(w->thread);
+   }
+
+   ParseResult *unused = (ParseResult *) atomic_exchange_ptr(&w->published, 0);
+   if (unused) {
+      ts_tree_delete(unused->tree);
+      free(unused);
+   }
+
+   if (w->base) {
+      ts_tree_delete(w->base);
+   }
+   ts_parser_delete(w->parser);
+
+   for (U32 i = 0; i < ARRAY_COUNT(w->snapshots); ++i) {
+      if (w->snapshots[i].arena.ptr) {
+         free_arena(&w->snapshots[i].arena, w->snapshots[i].arena.size);
+      }
+   }
+
+   if (w->text_arena.ptr) {
+      free_arena(&w->text_arena, w->text_arena.size);
+   }
+
+   os_condvar_release(w->cond);
+   os_mutex_release(w->mutex);
+
+   Arena arena = w->arena;
+   free_arena(&arena, arena.size);
+}
+
+void
+parse_worker_edit(ParseWorker *w, TSInputEdit edit)
+{
+   if (w->pending_count < PARSE_MAX_EDITS) {
+      w->pending[w->pending_count++] = edit;
+   } else {
+      w->pending_overflow = 1;
+   }
+
+   // the log is only an optimization, when it is full older trees are
+   // shown unadjusted until the next one arrives
+   if (w->log_count < PARSE_MAX_EDITS) {
+      w->log[w->log_count] = edit;
+      w->log_generation[w->log_count] = w->submitted + 1;
+      w->log_count++;
+   }
+}
+
+void
+parse_worker_submit(ParseWorker *w, TextBuffer *buf)
+{
+   os_mutex_lock(w->mutex);
+
+   // the snapshot the worker has not taken yet is replaced
+   ParseSnapshot *snapshot = &w->snapshots[w->next_snapshot];
+   if (buf->backend == BUFFER_GAP) {
+      parse_snapshot_gap(snapshot, &buf->gap, w->submitted_len, w->has_job);
+   } else {
+      parse_snapshot_pieces(snapshot, &buf->tree);
+   }
+   w->submitted_len = buf->len;
+
+   // edits of a snapshot the worker never took still belong to this one
+   if (w->pending_overflow || w->edit_count + w->pending_count > PARSE_MAX_EDITS) {
+      w->edits_overflow = 1;
+   } else {
+      MEM_COPY(w->edits + w->edit_count, w->pending, w->pending_count * sizeof(TSInputEdit));
+      w->edit_count += w->pending_count;
+   }
+
+   w->pending_count = 0;
+   w->pending_overflow = 0;
+   w->job_generation = ++w->submitted;
+   w->has_job = 1;
+
+   // stops the parse of an older snapshot, if one is running
+   atomic_store_u64(&w->cancel, 1);
+
+   os_condvar_signal(w->cond);
+   os_mutex_unlock(w->mutex);
+}
+
+TSTree *
+parse_worker_take(ParseWorker *w)
+{
+   ParseResult *result = (ParseResult *) atomic_exchange_ptr(&w->published, 0);
+   if (!result) {
+      return 0;
+   }
+
+   TSTree *tree = result->tree;
+
+   // edits made after the snapshot of this tree was taken
+   U32 kept = 0;
+   for (U32 i = 0; i < w->log_count; ++i) {
+      if (w->log_generation[i] > result->generation) {
+         ts_tree_edit(tree, &w->log[i]);
+         w->log[kept] = w->log[i];
+         w->log_generation[kept] = w->log_generation[i];
+         kept++;
+      }
+   }
+   w->log_count = kept;
+
+   free(result);
+   return tree;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "base/base_inc.h"
+
+#include "tree_sitter/api.h"
+
+struct TextBuffer;
+struct GapBuffer;
+struct PieceTree;
+
+enum
+{
+   PARSE_MAX_EDITS = 1024,
+   PARSE_MAX_TEXT = GIGA_BYTES(4), // reserved for the copy of a gap buffer, offsets are 32 bit
+};
+
+// The text as the ui thread handed it over. The pieces of a piece tree
+// never change once written, so only their list is copied. A gap buffer is
+// edited in place: the snapshot carries the bytes between the ends no edit
+// touched and the worker patches them into its own copy.
+struct ParseSnapshot
+{
+   Arena arena;
+
+   String8 *pieces;
+   U64 *starts; // offset of every piece
+   U64 piece_count;
+
+   B32 patch;
+   U64 base_len; // of the copy the patch applies to
+   U64 keep_before;
+   U64 keep_after;
+   String8 middle;
+};
+
+// what a TSInput reads from
+struct ParseText
+{
+   String8 *pieces;
+   U64 *starts;
+   U64 piece_count;
+   U64 last; // piece of the last read, reads mostly go on from there
+};
+
+struct ParseResult
+{
+   TSTree *tree;
+   U64 generation;
+};
+
+// Reparses on its own thread. The ui thread hands over a snapshot of the
+// text together with the edits made since the last hand over and never
+// waits for a parse. Finished trees are published through an atomic
+// pointer, a newer snapshot cancels the parse that is still running.
+struct ParseWorker
+{
+   Arena arena; // holds this struct
+
+   // worker thread only
+   TSParser *parser;
+   TSTree *base; // last finished tree
+   TSInputEdit base_edits[PARSE_MAX_EDITS]; // edits not in base yet
+   U32 base_edit_count;
+   B32 base_stale; // too many edits, parse from scratch
+   Arena text_arena;
+   String8 text; // copy of a gap buffer, patched by every snapshot
+
+   // guarded by mutex
+   OS_Handle mutex;
+   OS_Handle cond;
+   ParseSnapshot snapshots[2];
+   U32 next_snapshot; // the one the ui thread writes
+   TSInputEdit edits[PARSE_MAX_EDITS];
+   U32 edit_count;
+   B32 edits_overflow;
+   U64 job_generation;
+   B32 has_job;
+   B32 quit;
+
+   U64 cancel; // atomic, the tree-sitter cancellation flag
+   ParseResult *published; // atomic
+
+   // ui thread only. Edits wait in pending until the next submit, the log
+   // keeps them with their generation to bring older trees up to date.
+   TSInputEdit pending[PARSE_MAX_EDITS];
+   U32 pending_count;
+   B32 pending_overflow;
+   TSInputEdit log[PARSE_MAX_EDITS];
+   U64 log_generation[PARSE_MAX_EDITS];
+   U32 log_count;
+   U64 submitted;
+   U64 submitted_len; // of the text in the last snapshot
+
+   OS_Handle thread;
+};
+
+typedef void ParseWakeFunc(void);
+
+// called on a worker thread after it published a tree, so the ui thread
+// can sleep until there is something new to show
+intern void parse_worker_set_wake(ParseWakeFunc *wake);
+
+intern ParseWorker *parse_worker_start(const TSLanguage *lang);
+intern void parse_worker_stop(ParseWorker *w);
+
+// ui thread: records an edit, takes a snapshot for the worker and picks up
+// the newest finished tree
+intern void parse_worker_edit(ParseWorker *w, TSInputEdit edit);
+intern void parse_worker_submit(ParseWorker *w, TextBuffer *buf);
+intern TSTree *parse_worker_take(ParseWorker *w);
+
+// ui thread, with the lock held when the worker can see the snapshot. The
+// edits of a patch the worker has not taken yet are merged into the new one.
+intern void parse_snapshot_gap(ParseSnapshot *s, GapBuffer *gb, U64 base_len, B32 merge);
+intern void parse_snapshot_pieces(ParseSnapshot *s, PieceTree *pt);
+
+// worker thread: the text the snapshot stands for
+intern ParseText parse_snapshot_text(ParseSnapshot *s, Arena *text_arena, String8 *text);
+intern const char *parse_text_read(void *payload, U32 byte_index, TSPoint position, U32 *bytes_read);
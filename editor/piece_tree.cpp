@@ -0,0 +1,470 @@
+#include "piece_tree.h"
+
+
+intern U32
+piece_tree_random(PieceTree *pt)
+{
+   // xorshift32
+   U32 x = pt->seed;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   pt->seed = x;
+
+   return x;
+}
+
+intern NKINLINE U64
+piece_subtree_len(PieceNode *n)
+{
+   return n ? n->subtree_len : 0;
+}
+
+intern NKINLINE U64
+piece_subtree_lf(PieceNode *n)
+{
+   return n ? n->subtree_lf : 0;
+}
+
+intern NKINLINE void
+piece_update(PieceNode *n)
+{
+   n->subtree_len = piece_subtree_len(n->left) + n->len + piece_subtree_len(n->right);
+   n->subtree_lf = piece_subtree_lf(n->left) + n->lf + piece_subtree_lf(n->right);
+}
+
+intern PieceNode *
+piece_node_new(PieceTree *pt, U8 *ptr, U64 len, U64 lf, U32 priority)
+{
+   PieceNode *n = pool_alloc_struct(&pt->nodes, PieceNode);
+
+   n->left = 0;
+   n->right = 0;
+   n->ptr = ptr;
+   n->len = len;
+   n->lf = lf;
+   n->subtree_len = len;
+   n->subtree_lf = lf;
+   n->priority = priority;
+
+   return n;
+}
+
+// splits the tree so that the left part holds the first pos bytes
+intern void
+piece_split(PieceTree *pt, PieceNode *n, U64 pos, PieceNode **l, PieceNode **r)
+{
+   if (!n) {
+      *l = 0;
+      *r = 0;
+      return;
+   }
+
+   U64 left_len = piece_subtree_len(n->left);
+
+   if (pos <= left_len) {
+      piece_split(pt, n->left, pos, l, &n->left);
+      piece_update(n);
+      *r = n;
+   } else if (pos >= left_len + n->len) {
+      piece_split(pt, n->right, pos - left_len - n->len, &n->right, r);
+      piece_update(n);
+      *l = n;
+   } else {
+      // split inside the piece. The tail keeps the priority of n so the
+      // heap property holds for the right subtree it takes over.
+      U64 off = pos - left_len;
+      U64 head_lf = count_newlines(n->ptr, off);
+
+      PieceNode *tail = piece_node_new(pt, n->ptr + off, n->len - off, n->lf - head_lf, n->priority);
+      tail->right = n->right;
+      piece_update(tail);
+
+      n->len = off;
+      n->lf = head_lf;
+      n->right = 0;
+      piece_update(n);
+
+      *l = n;
+      *r = tail;
+   }
+}
+
+intern void
+piece_free_nodes(PieceTree *pt, PieceNode *n)
+{
+   while (n) {
+      piece_free_nodes(pt, n->left);
+
+      PieceNode *right = n->right;
+      pool_free(&pt->nodes, n);
+      n = right;
+   }
+}
+
+intern PieceNode *
+piece_merge(PieceNode *a, PieceNode *b)
+{
+   if (!a) return b;
+   if (!b) return a;
+
+   if (a->priority >= b->priority) {
+      a->right = piece_merge(a->right, b);
+      piece_update(a);
+      return a;
+   } else {
+      b->left = piece_merge(a, b->left);
+      piece_update(b);
+      return b;
+   }
+}
+
+// grows the piece that ends at pos if it also ends at the top of the add
+// buffer, so typing a run of characters does not create a node per key
+intern B32
+piece_extend(PieceNode *n, U64 pos, U8 *add_top, U64 count)
+{
+   while (n) {
+      U64 left_len = piece_subtree_len(n->left);
+
+      if (pos <= left_len) {
+         n = n->left;
+      } else if (pos > left_len + n->len) {
+         pos -= left_len + n->len;
+         n = n->right;
+      } else {
+         return pos == left_len + n->len && n->ptr + n->len == add_top && n->len + count <= PIECE_MAX_LEN;
+      }
+   }
+
+   return 0;
+}
+
+intern void
+piece_grow(PieceNode *n, U64 pos, U64 count, U64 lf)
+{
+   while (n) {
+      n->subtree_len += count;
+      n->subtree_lf += lf;
+
+      U64 left_len = piece_subtree_len(n->left);
+
+      if (pos <= left_len) {
+         n = n->left;
+      } else if (pos > left_len + n->len) {
+         pos -= left_len + n->len;
+         n = n->right;
+      } else {
+         n->len += count;
+         n->lf += lf;
+         return;
+      }
+   }
+}
+
+intern String8
+piece_find(PieceNode *n, U64 pos, U64 *piece_start)
+{
+   U64 start = 0;
+
+   while (n) {
+      U64 left_len = piece_subtree_len(n->left);
+
+      if (pos < left_len) {
+         n = n->left;
+      } else if (pos >= left_len + n->len) {
+         pos -= left_len + n->len;
+         start += left_len + n->len;
+         n = n->right;
+      } else {
+         *piece_start = start + left_len;
+         return String8(n->ptr, n->len);
+      }
+   }
+
+   return null_str8;
+}
+
+intern NKINLINE void
+piece_tree_invalidate_cache(PieceTree *pt)
+{
+   pt->cache_ptr = 0;
+   pt->cache_start = 0;
+   pt->cache_len = 0;
+}
+
+U8
+PieceTree::operator[](U64 index) const
+{
+   ASSERT(index < len);
+
+   if_unlikely (index - cache_start >= cache_len) {
+      String8 piece = piece_find(root, index, &cache_start);
+      cache_ptr = piece.ptr;
+      cache_len = piece.len;
+   }
+
+   return cache_ptr[index - cache_start];
+}
+
+PieceTree
+piece_tree_from_arena(Arena a)
+{
+   PieceTree pt = {};
+
+   Arena nodes = {};
+   sub_arena(&nodes, &a, a.size / 4);
+   arena_set_name(&nodes, "piece nodes");
+   init_pool_of(&pt.nodes, nodes, PieceNode);
+
+   pt.add = a.ptr + a.top;
+   pt.add_cap = a.size - a.top;
+   pt.seed = 0x9E3779B9;
+
+   return pt;
+}
+
+// adds a piece at the end without copying it, used while a file loads
+void
+piece_tree_append(PieceTree *pt, U8 *ptr, U64 len, U64 lf)
+{
+   ASSERT(len <= PIECE_MAX_LEN);
+
+   PieceNode *n = piece_node_new(pt, ptr, len, lf, piece_tree_random(pt));
+   pt->root = piece_merge(pt->root, n);
+   pt->len += len;
+
+   piece_tree_invalidate_cache(pt);
+}
+
+void
+piece_tree_release(PieceTree *pt)
+{
+   release_pool(&pt->nodes);
+
+   if (pt->file.ptr) {
+      os_unmap_file(pt->file);
+      pt->file = null_str8;
+   }
+}
+
+U64
+insert_char(PieceTree *pt, U8 c, U64 pos)
+{
+   return insert_string(pt, String8(&c, 1), pos);
+}
+
+U64
+insert_string(PieceTree *pt, String8 s, U64 pos)
+{
+   ASSERT(pt->add_len + s.len <= pt->add_cap);
+
+   if (pos > pt->len || s.len == 0) {
+      return pos;
+   }
+
+   pt->add_committed = commit_grow(pt->add, pt->add_committed, pt->add_len + s.len, pt->add_cap);
+
+   U8 *add_top = pt->add + pt->add_len;
+   MEM_COPY(add_top, s.ptr, s.len);
+   pt->add_len += s.len;
+
+   if (pos > 0 && piece_extend(pt->root, pos, add_top, s.len)) {
+      piece_grow(pt->root, pos, s.len, count_newlines(s.ptr, s.len));
+   } else {
+      PieceNode *l, *r;
+      piece_split(pt, pt->root, pos, &l, &r);
+
+      // long inserts are cut into several pieces
+      for (U64 off = 0; off < s.len; off += PIECE_MAX_LEN) {
+         U64 len = MIN(s.len - off, (U64)PIECE_MAX_LEN);
+         U64 lf = count_newlines(add_top + off, len);
+
+         PieceNode *n = piece_node_new(pt, add_top + off, len, lf, piece_tree_random(pt));
+         l = piece_merge(l, n);
+      }
+
+      pt->root = piece_merge(l, r);
+   }
+
+   pt->len += s.len;
+   piece_tree_invalidate_cache(pt);
+
+   return pos + s.len;
+}
+
+intern void
+piece_tree_delete_bytes(PieceTree *pt, U64 pos, U64 size)
+{
+   PieceNode *l, *m, *r;
+   piece_split(pt, pt->root, pos, &l, &r);
+   piece_split(pt, r, size, &m, &r);
+
+   pt->root = piece_merge(l, r);
+   piece_free_nodes(pt, m);
+
+   pt->len -= size;
+   piece_tree_invalidate_cache(pt);
+}
+
+U64
+delete_char(PieceTree *pt, U64 pos)
+{
+   if (pos >= pt->len) {
+      return pos;
+   }
+
+   U32 cl = utf8_len((*pt)[pos]);
+   piece_tree_delete_bytes(pt, pos, MIN((U64)cl, pt->len - pos));
+
+   return pos;
+}
+
+U64
+delete_chars(PieceTree *pt, U64 pos, U64 n)
+{
+   if (pos + n >= pt->len) {
+      return pos;
+   }
+
+   U64 size = 0;
+   while (n > 0 && pos + size < pt->len) {
+      size += utf8_len((*pt)[pos + size]);
+      n--;
+   }
+
+   piece_tree_delete_bytes(pt, pos, MIN(size, pt->len - pos));
+
+   return pos;
+}
+
+U64
+piece_tree_newline_count(PieceTree *pt)
+{
+   return piece_subtree_lf(pt->root);
+}
+
+U64
+piece_tree_newline_offset(PieceTree *pt, U64 k)
+{
+   ASSERT(k < piece_tree_newline_count(pt));
+
+   PieceNode *n = pt->root;
+   U64 start = 0;
+
+   while (n) {
+      U64 left_lf = piece_subtree_lf(n->left);
+
+      if (k < left_lf) {
+         n = n->left;
+         continue;
+      }
+
+      k -= left_lf;
+      start += piece_subtree_len(n->left);
+
+      if (k < n->lf) {
+         U64 i = find_newline(n->ptr, n->len);
+         while (k > 0) {
+            i += 1 + find_newline(n->ptr + i + 1, n->len - i - 1);
+            k--;
+         }
+
+         return start + i;
+      }
+
+      k -= n->lf;
+      start += n->len;
+      n = n->right;
+   }
+
+   return pt->len;
+}
+
+U64
+piece_tree_newlines_before(PieceTree *pt, U64 pos)
+{
+   PieceNode *n = pt->root;
+   U64 count = 0;
+
+   while (n) {
+      U64 left_len = piece_subtree_len(n->left);
+
+      if (pos < left_len) {
+         n = n->left;
+      } else if (pos >= left_len + n->len) {
+         count += piece_subtree_lf(n->left) + n->lf;
+         pos -= left_len + n->len;
+         n = n->right;
+      } else {
+         count += piece_subtree_lf(n->left) + count_newlines(n->ptr, pos - left_len);
+         break;
+      }
+   }
+
+   return count;
+}
+
+String8
+piece_tree_chunk_at(PieceTree *pt, U64 pos)
+{
+   if (pos >= pt->len) {
+      return null_str8;
+   }
+
+   U64 start = 0;
+   String8 piece = piece_find(pt->root, pos, &start);
+
+   return String8(piece.ptr + (pos - start), piece.len - (pos - start));
+}
+
+String8
+piece_tree_chunk_before(PieceTree *pt, U64 pos)
+{
+   if (pos == 0 || pos > pt->len) {
+      return null_str8;
+   }
+
+   U64 start = 0;
+   String8 piece = piece_find(pt->root, pos - 1, &start);
+
+   return String8(piece.ptr, pos - start);
+}
+
+String8
+str8_from_piece_tree(PieceTree *pt, Arena *a)
+{
+   String8 s = {};
+   s.ptr = push_array(a, U8, pt->len + 1);
+   s.len = pt->len;
+
+   U64 pos = 0;
+   while (pos < pt->len) {
+      String8 chunk = piece_tree_chunk_at(pt, pos);
+      MEM_COPY(s.ptr + pos, chunk.ptr, chunk.len);
+      pos += chunk.len;
+   }
+   s.ptr[s.len] = 0;
+
+   return s;
+}
+
+intern U64
+piece_collect(PieceNode *n, String8 *out, U64 count)
+{
+   for (; n; n = n->right) {
+      count = piece_collect(n->left, out, count);
+
+      if (n->len) {
+         out[count++] = String8(n->ptr, n->len);
+      }
+   }
+
+   return count;
+}
+
+U64
+piece_tree_pieces(PieceTree *pt, String8 *out)
+{
+   return piece_collect(pt->root, out, 0);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "base/base_inc.h"
+#include "math/scan_inc.h"
+
+enum
+{
+   // bounds the scan for newlines inside a single piece, also the page
+   // size a mapped file is split by
+   PIECE_MAX_LEN = 4096,
+};
+
+// Balanced piece tree (treap keyed by byte offset).
+// Pieces point into the append-only add buffer, so edits never move existing text.
+struct PieceNode
+{
+   PieceNode *left;
+   PieceNode *right;
+
+   U8 *ptr;
+   U64 len;
+   U64 lf; // newlines in the piece
+   U64 subtree_len;
+   U64 subtree_lf;
+
+   U32 priority;
+};
+
+struct PieceTree
+{
+   PieceNode *root;
+   Pool nodes; // nodes cut out by deletes are reused
+
+   U8 *add;
+   U64 add_len;
+   U64 add_cap;
+   U64 add_committed;
+
+   // read-only mapping of the loaded file, unedited pieces point into it
+   String8 file;
+
+   U64 len;
+   U32 seed;
+
+   // last piece looked up by operator[], makes sequential reads O(1)
+   mutable U8 *cache_ptr;
+   mutable U64 cache_start;
+   mutable U64 cache_len;
+
+   U8 operator[](U64 index) const;
+};
+
+intern PieceTree piece_tree_from_arena(Arena a);
+intern void piece_tree_append(PieceTree *pt, U8 *ptr, U64 len, U64 lf);
+intern void piece_tree_release(PieceTree *pt);
+
+intern U64 insert_char(PieceTree *pt, U8 c, U64 pos);
+intern U64 insert_string(PieceTree *pt, String8 s, U64 pos);
+intern U64 delete_char(PieceTree *pt, U64 pos);
+intern U64 delete_chars(PieceTree *pt, U64 pos, U64 n);
+
+intern U64 piece_tree_newline_count(PieceTree *pt);
+intern U64 piece_tree_newline_offset(PieceTree *pt, U64 k);
+intern U64 piece_tree_newlines_before(PieceTree *pt, U64 pos);
+
+intern String8 piece_tree_chunk_at(PieceTree *pt, U64 pos);
+intern String8 piece_tree_chunk_before(PieceTree *pt, U64 pos);
+intern String8 str8_from_piece_tree(PieceTree *pt, Arena *a);
+
+// the pieces in text order, out has room for the live nodes of the pool
+intern U64 piece_tree_pieces(PieceTree *pt, String8 *out);
@@ -45,6 +45,20 @@ window_on_char_event(GLFWwindow *handle, unsigned int codepoint)
    }
 }
 
+intern void
+window_on_refresh(GLFWwindow *handle)
+{
+   Window *window = (Window *)glfwGetWindowUserPointer(handle);
+   ASSERT(window);
+
+   WindowCallbacks callbacks = window->callbacks;
+   WindowRefreshCallbackFn callback = callbacks.refresh;
+
+   if (callback != 0) {
+      callback(callbacks.ctx);
+   }
+}
+
 void
 init_window(Window *window, const char *title)
 {
@@ -77,6 +91,7 @@ init_window(Window *window, const char *title)
    glfwSetFramebufferSizeCallback(window->handle, window_on_frame_buffer_resize);
    glfwSetKeyCallback(window->handle, window_on_key_event);
    glfwSetCharCallback(window->handle, window_on_char_event);
+   glfwSetWindowRefreshCallback(window->handle, window_on_refresh);
 }
 
 void
@@ -93,9 +108,24 @@ should_close_window(Window *window)
 }
 
 void
-update_window(Window *window)
+wait_window_events(Window *window, double timeout)
+{
+   if (timeout > 0) {
+      glfwWaitEventsTimeout(timeout);
+   } else {
+      glfwPollEvents();
+   }
+}
+
+void
+wake_window(void)
+{
+   glfwPostEmptyEvent();
+}
+
+void
+swap_window(Window *window)
 {
-   glfwPollEvents();
    glfwSwapBuffers(window->handle);
 }
 
@@ -5,6 +5,7 @@
 typedef void (*WindowKeyCallbackFn)(void *ctx, int key, int scancode, int action, int mods);
 typedef void (*WindowCharCallbackFn)(void *ctx, unsigned int codepoint);
 typedef void (*WindowResizeCallbackFn)(void *ctx, int width, int height);
+typedef void (*WindowRefreshCallbackFn)(void *ctx);
 
 struct WindowCallbacks
 {
@@ -12,6 +13,7 @@ struct WindowCallbacks
    WindowKeyCallbackFn key;
    WindowCharCallbackFn text;
    WindowResizeCallbackFn resize;
+   WindowRefreshCallbackFn refresh; // the contents were damaged by the system
 };
 
 struct Window
@@ -26,6 +28,10 @@ intern void init_window(Window *window, const char *title);
 intern void destroy_window(Window *window);
 
 intern B32 should_close_window(Window *window);
-intern void update_window(Window *window);
+// sleeps until an event arrives or timeout seconds passed, then runs the callbacks
+intern void wait_window_events(Window *window, double timeout);
+// wakes wait_window_events from any thread
+intern void wake_window(void);
+intern void swap_window(Window *window);
 
 intern void set_window_callbacks(Window *window, WindowCallbacks callbacks);
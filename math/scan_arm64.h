@@ -0,0 +1,85 @@
+#pragma once
+
+#include <arm_neon.h>
+
+enum
+{
+   SCAN_WIDTH = 16
+};
+
+typedef uint8x16_t ScanVec;
+
+intern inline ScanVec scan_load(const U8 *p) { return vld1q_u8(p); }
+intern inline ScanVec scan_splat(U8 c) { return vdupq_n_u8(c); }
+intern inline ScanVec scan_eq(ScanVec a, ScanVec b) { return vceqq_u8(a, b); }
+intern inline ScanVec scan_and(ScanVec a, ScanVec b) { return vandq_u8(a, b); }
+
+// NEON has no movemask, narrowing by 4 leaves four bits per byte
+intern inline U64
+scan_mask(ScanVec v)
+{
+   uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(v), 4);
+   return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+
+intern inline U64
+scan_count(const U8 *ptr, U64 blocks)
+{
+   uint8x16_t nl = vdupq_n_u8('\n');
+   U64 total = 0;
+
+   // byte counters overflow after 255 blocks
+   while (blocks > 0) {
+      U64 n = MIN(blocks, (U64)255);
+      uint8x16_t acc = vdupq_n_u8(0);
+
+      for (U64 i = 0; i < n; ++i) {
+         acc = vsubq_u8(acc, vceqq_u8(vld1q_u8(ptr), nl));
+         ptr += SCAN_WIDTH;
+      }
+
+      total += vaddlvq_u8(acc);
+      blocks -= n;
+   }
+
+   return total;
+}
+
+// four bits per byte
+enum
+{
+   SCAN_MASK_SHIFT = 2
+};
+
+// Packs the bytes that are not '\r' to the front of dst, each 8 byte half
+// with a table lookup. Blocks without one are stored whole.
+intern inline U64
+scan_strip_cr(U8 *dst, const U8 *src, U64 blocks)
+{
+   uint8x16_t cr = vdupq_n_u8('\r');
+   const U8 lane_bits[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+   uint8x8_t bits = vld1_u8(lane_bits);
+   U8 *out = dst;
+
+   for (U64 i = 0; i < blocks; ++i, src += STRIP_WIDTH) {
+      uint8x16_t v = vld1q_u8(src);
+      uint8x16_t eq = vceqq_u8(v, cr);
+
+      if_likely (vmaxvq_u8(eq) == 0) {
+         vst1q_u8(out, v);
+         out += STRIP_WIDTH;
+         continue;
+      }
+
+      U32 lo = vaddv_u8(vand_u8(vget_low_u8(eq), bits));
+      U32 hi = vaddv_u8(vand_u8(vget_high_u8(eq), bits));
+
+      vst1_u8(out, vtbl1_u8(vget_low_u8(v), vcreate_u8(strip_cr_shuffle[lo])));
+      out += strip_cr_kept[lo];
+
+      vst1_u8(out, vtbl1_u8(vget_high_u8(v), vcreate_u8(strip_cr_shuffle[hi])));
+      out += strip_cr_kept[hi];
+   }
+
+   return (U64)(out - dst);
+}
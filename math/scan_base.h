@@ -0,0 +1,204 @@
+#pragma once
+
+#include "base/base.h"
+
+#if COMPILER_MSVC
+#include <intrin.h>
+#endif
+
+// Byte scanning kernels over one contiguous range. The find functions
+// return len when nothing was found.
+
+enum
+{
+   // the carriage return stripping kernels work on 16 byte blocks
+   STRIP_WIDTH = 16
+};
+
+intern inline U32
+ctz_u64(U64 x)
+{
+   ASSERT(x != 0);
+#if COMPILER_MSVC
+   unsigned long index;
+   _BitScanForward64(&index, x);
+   return (U32)index;
+#else
+   return (U32)__builtin_ctzll(x);
+#endif
+}
+
+intern inline U32
+clz_u64(U64 x)
+{
+   ASSERT(x != 0);
+#if COMPILER_MSVC
+   unsigned long index;
+   _BitScanReverse64(&index, x);
+   return 63 - (U32)index;
+#else
+   return (U32)__builtin_clzll(x);
+#endif
+}
+
+intern inline U32
+popcount_u32(U32 x)
+{
+#if COMPILER_MSVC
+   return (U32)__popcnt(x);
+#else
+   return (U32)__builtin_popcount(x);
+#endif
+}
+
+intern inline U64
+count_newlines_scalar(const U8 *ptr, U64 len)
+{
+   U64 count = 0;
+   for (U64 i = 0; i < len; ++i) {
+      count += ptr[i] == '\n';
+   }
+
+   return count;
+}
+
+intern inline U64
+find_newline_scalar(const U8 *ptr, U64 len)
+{
+   for (U64 i = 0; i < len; ++i) {
+      if (ptr[i] == '\n') {
+         return i;
+      }
+   }
+
+   return len;
+}
+
+intern inline U64
+find_newline_reverse_scalar(const U8 *ptr, U64 len)
+{
+   for (U64 i = len; i > 0; --i) {
+      if (ptr[i - 1] == '\n') {
+         return i - 1;
+      }
+   }
+
+   return len;
+}
+
+// index of the first "\n\n"
+intern inline U64
+find_double_newline_scalar(const U8 *ptr, U64 len)
+{
+   for (U64 i = 0; i + 1 < len; ++i) {
+      if (ptr[i] == '\n' && ptr[i + 1] == '\n') {
+         return i;
+      }
+   }
+
+   return len;
+}
+
+// copies len bytes without carriage returns and returns how many were
+// written, dst may be the same as src
+intern inline U64
+strip_cr_scalar(U8 *dst, const U8 *src, U64 len)
+{
+   U64 n = 0;
+   for (U64 i = 0; i < len; ++i) {
+      dst[n] = src[i];
+      n += src[i] != '\r';
+   }
+
+   return n;
+}
+
+// byte shuffles that pack the bytes of an 8 byte lane whose bit is clear in
+// the index to the front. 0x80 selects zero on both pshufb and tbl.
+global read_only U64 strip_cr_shuffle[256] = {
+   0x0706050403020100ULL, 0x8007060504030201ULL, 0x8007060504030200ULL, 0x8080070605040302ULL,
+   0x8007060504030100ULL, 0x8080070605040301ULL, 0x8080070605040300ULL, 0x8080800706050403ULL,
+   0x8007060504020100ULL, 0x8080070605040201ULL, 0x8080070605040200ULL, 0x8080800706050402ULL,
+   0x8080070605040100ULL, 0x8080800706050401ULL, 0x8080800706050400ULL, 0x8080808007060504ULL,
+   0x8007060503020100ULL, 0x8080070605030201ULL, 0x8080070605030200ULL, 0x8080800706050302ULL,
+   0x8080070605030100ULL, 0x8080800706050301ULL, 0x8080800706050300ULL, 0x8080808007060503ULL,
+   0x8080070605020100ULL, 0x8080800706050201ULL, 0x8080800706050200ULL, 0x8080808007060502ULL,
+   0x8080800706050100ULL, 0x8080808007060501ULL, 0x8080808007060500ULL, 0x8080808080070605ULL,
+   0x8007060403020100ULL, 0x8080070604030201ULL, 0x8080070604030200ULL, 0x8080800706040302ULL,
+   0x8080070604030100ULL, 0x8080800706040301ULL, 0x8080800706040300ULL, 0x8080808007060403ULL,
+   0x8080070604020100ULL, 0x8080800706040201ULL, 0x8080800706040200ULL, 0x8080808007060402ULL,
+   0x8080800706040100ULL, 0x8080808007060401ULL, 0x8080808007060400ULL, 0x8080808080070604ULL,
+   0x8080070603020100ULL, 0x8080800706030201ULL, 0x8080800706030200ULL, 0x8080808007060302ULL,
+   0x8080800706030100ULL, 0x8080808007060301ULL, 0x8080808007060300ULL, 0x8080808080070603ULL,
+   0x8080800706020100ULL, 0x8080808007060201ULL, 0x8080808007060200ULL, 0x8080808080070602ULL,
+   0x8080808007060100ULL, 0x8080808080070601ULL, 0x8080808080070600ULL, 0x8080808080800706ULL,
+   0x8007050403020100ULL, 0x8080070504030201ULL, 0x8080070504030200ULL, 0x8080800705040302ULL,
+   0x8080070504030100ULL, 0x8080800705040301ULL, 0x8080800705040300ULL, 0x8080808007050403ULL,
+   0x8080070504020100ULL, 0x8080800705040201ULL, 0x8080800705040200ULL, 0x8080808007050402ULL,
+   0x8080800705040100ULL, 0x8080808007050401ULL, 0x8080808007050400ULL, 0x8080808080070504ULL,
+   0x8080070503020100ULL, 0x8080800705030201ULL, 0x8080800705030200ULL, 0x8080808007050302ULL,
+   0x8080800705030100ULL, 0x8080808007050301ULL, 0x8080808007050300ULL, 0x8080808080070503ULL,
+   0x8080800705020100ULL, 0x8080808007050201ULL, 0x8080808007050200ULL, 0x8080808080070502ULL,
+   0x8080808007050100ULL, 0x8080808080070501ULL, 0x8080808080070500ULL, 0x8080808080800705ULL,
+   0x8080070403020100ULL, 0x8080800704030201ULL, 0x8080800704030200ULL, 0x8080808007040302ULL,
+   0x8080800704030100ULL, 0x8080808007040301ULL, 0x8080808007040300ULL, 0x8080808080070403ULL,
+   0x8080800704020100ULL, 0x8080808007040201ULL, 0x8080808007040200ULL, 0x8080808080070402ULL,
+   0x8080808007040100ULL, 0x8080808080070401ULL, 0x8080808080070400ULL, 0x8080808080800704ULL,
+   0x8080800703020100ULL, 0x8080808007030201ULL, 0x8080808007030200ULL, 0x8080808080070302ULL,
+   0x8080808007030100ULL, 0x8080808080070301ULL, 0x8080808080070300ULL, 0x8080808080800703ULL,
+   0x8080808007020100ULL, 0x8080808080070201ULL, 0x8080808080070200ULL, 0x8080808080800702ULL,
+   0x8080808080070100ULL, 0x8080808080800701ULL, 0x8080808080800700ULL, 0x8080808080808007ULL,
+   0x8006050403020100ULL, 0x8080060504030201ULL, 0x8080060504030200ULL, 0x8080800605040302ULL,
+   0x8080060504030100ULL, 0x8080800605040301ULL, 0x8080800605040300ULL, 0x8080808006050403ULL,
+   0x8080060504020100ULL, 0x8080800605040201ULL, 0x8080800605040200ULL, 0x8080808006050402ULL,
+   0x8080800605040100ULL, 0x8080808006050401ULL, 0x8080808006050400ULL, 0x8080808080060504ULL,
+   0x8080060503020100ULL, 0x8080800605030201ULL, 0x8080800605030200ULL, 0x8080808006050302ULL,
+   0x8080800605030100ULL, 0x8080808006050301ULL, 0x8080808006050300ULL, 0x8080808080060503ULL,
+   0x8080800605020100ULL, 0x8080808006050201ULL, 0x8080808006050200ULL, 0x8080808080060502ULL,
+   0x8080808006050100ULL, 0x8080808080060501ULL, 0x8080808080060500ULL, 0x8080808080800605ULL,
+   0x8080060403020100ULL, 0x8080800604030201ULL, 0x8080800604030200ULL, 0x8080808006040302ULL,
+   0x8080800604030100ULL, 0x8080808006040301ULL, 0x8080808006040300ULL, 0x8080808080060403ULL,
+   0x8080800604020100ULL, 0x8080808006040201ULL, 0x8080808006040200ULL, 0x8080808080060402ULL,
+   0x8080808006040100ULL, 0x8080808080060401ULL, 0x8080808080060400ULL, 0x8080808080800604ULL,
+   0x8080800603020100ULL, 0x8080808006030201ULL, 0x8080808006030200ULL, 0x8080808080060302ULL,
+   0x8080808006030100ULL, 0x8080808080060301ULL, 0x8080808080060300ULL, 0x8080808080800603ULL,
+   0x8080808006020100ULL, 0x8080808080060201ULL, 0x8080808080060200ULL, 0x8080808080800602ULL,
+   0x8080808080060100ULL, 0x8080808080800601ULL, 0x8080808080800600ULL, 0x8080808080808006ULL,
+   0x8080050403020100ULL, 0x8080800504030201ULL, 0x8080800504030200ULL, 0x8080808005040302ULL,
+   0x8080800504030100ULL, 0x8080808005040301ULL, 0x8080808005040300ULL, 0x8080808080050403ULL,
+   0x8080800504020100ULL, 0x8080808005040201ULL, 0x8080808005040200ULL, 0x8080808080050402ULL,
+   0x8080808005040100ULL, 0x8080808080050401ULL, 0x8080808080050400ULL, 0x8080808080800504ULL,
+   0x8080800503020100ULL, 0x8080808005030201ULL, 0x8080808005030200ULL, 0x8080808080050302ULL,
+   0x8080808005030100ULL, 0x8080808080050301ULL, 0x8080808080050300ULL, 0x8080808080800503ULL,
+   0x8080808005020100ULL, 0x8080808080050201ULL, 0x8080808080050200ULL, 0x8080808080800502ULL,
+   0x8080808080050100ULL, 0x8080808080800501ULL, 0x8080808080800500ULL, 0x8080808080808005ULL,
+   0x8080800403020100ULL, 0x8080808004030201ULL, 0x8080808004030200ULL, 0x8080808080040302ULL,
+   0x8080808004030100ULL, 0x8080808080040301ULL, 0x8080808080040300ULL, 0x8080808080800403ULL,
+   0x8080808004020100ULL, 0x8080808080040201ULL, 0x8080808080040200ULL, 0x8080808080800402ULL,
+   0x8080808080040100ULL, 0x8080808080800401ULL, 0x8080808080800400ULL, 0x8080808080808004ULL,
+   0x8080808003020100ULL, 0x8080808080030201ULL, 0x8080808080030200ULL, 0x8080808080800302ULL,
+   0x8080808080030100ULL, 0x8080808080800301ULL, 0x8080808080800300ULL, 0x8080808080808003ULL,
+   0x8080808080020100ULL, 0x8080808080800201ULL, 0x8080808080800200ULL, 0x8080808080808002ULL,
+   0x8080808080800100ULL, 0x8080808080808001ULL, 0x8080808080808000ULL, 0x8080808080808080ULL,
+};
+
+// bytes kept by the shuffle above, popcount is a library call on targets
+// without the instruction
+global read_only U8 strip_cr_kept[256] = {
+   8, 7, 7, 6, 7, 6, 6, 5, 7, 6, 6, 5, 6, 5, 5, 4,
+   7, 6, 6, 5, 6, 5, 5, 4, 6, 5, 5, 4, 5, 4, 4, 3,
+   7, 6, 6, 5, 6, 5, 5, 4, 6, 5, 5, 4, 5, 4, 4, 3,
+   6, 5, 5, 4, 5, 4, 4, 3, 5, 4, 4, 3, 4, 3, 3, 2,
+   7, 6, 6, 5, 6, 5, 5, 4, 6, 5, 5, 4, 5, 4, 4, 3,
+   6, 5, 5, 4, 5, 4, 4, 3, 5, 4, 4, 3, 4, 3, 3, 2,
+   6, 5, 5, 4, 5, 4, 4, 3, 5, 4, 4, 3, 4, 3, 3, 2,
+   5, 4, 4, 3, 4, 3, 3, 2, 4, 3, 3, 2, 3, 2, 2, 1,
+   7, 6, 6, 5, 6, 5, 5, 4, 6, 5, 5, 4, 5, 4, 4, 3,
+   6, 5, 5, 4, 5, 4, 4, 3, 5, 4, 4, 3, 4, 3, 3, 2,
+   6, 5, 5, 4, 5, 4, 4, 3, 5, 4, 4, 3, 4, 3, 3, 2,
+   5, 4, 4, 3, 4, 3, 3, 2, 4, 3, 3, 2, 3, 2, 2, 1,
+   6, 5, 5, 4, 5, 4, 4, 3, 5, 4, 4, 3, 4, 3, 3, 2,
+   5, 4, 4, 3, 4, 3, 3, 2, 4, 3, 3, 2, 3, 2, 2, 1,
+   5, 4, 4, 3, 4, 3, 3, 2, 4, 3, 3, 2, 3, 2, 2, 1,
+   4, 3, 3, 2, 3, 2, 2, 1, 3, 2, 2, 1, 2, 1, 1, 0,
+};
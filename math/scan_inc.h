@@ -0,0 +1,99 @@
+#pragma once
+
+#include "scan_base.h"
+
+#if defined(ARCH_X64)
+#include "scan_x64.h"
+#define SCAN_SIMD 1
+#elif defined(ARCH_ARM64)
+#include "scan_arm64.h"
+#define SCAN_SIMD 1
+#else
+#define SCAN_SIMD 0
+#endif
+
+#if SCAN_SIMD
+
+intern inline U64
+count_newlines(const U8 *ptr, U64 len)
+{
+   U64 blocks = len / SCAN_WIDTH;
+   U64 done = blocks * SCAN_WIDTH;
+
+   return scan_count(ptr, blocks) + count_newlines_scalar(ptr + done, len - done);
+}
+
+intern inline U64
+find_newline(const U8 *ptr, U64 len)
+{
+   ScanVec nl = scan_splat('\n');
+
+   U64 i = 0;
+   for (; i + SCAN_WIDTH <= len; i += SCAN_WIDTH) {
+      U64 mask = scan_mask(scan_eq(scan_load(ptr + i), nl));
+      if (mask) {
+         return i + (ctz_u64(mask) >> SCAN_MASK_SHIFT);
+      }
+   }
+
+   return i + find_newline_scalar(ptr + i, len - i);
+}
+
+intern inline U64
+find_newline_reverse(const U8 *ptr, U64 len)
+{
+   ScanVec nl = scan_splat('\n');
+
+   U64 i = len;
+   for (; i >= SCAN_WIDTH; i -= SCAN_WIDTH) {
+      U64 mask = scan_mask(scan_eq(scan_load(ptr + i - SCAN_WIDTH), nl));
+      if (mask) {
+         return i - SCAN_WIDTH + ((63 - clz_u64(mask)) >> SCAN_MASK_SHIFT);
+      }
+   }
+
+   U64 found = find_newline_reverse_scalar(ptr, i);
+   return found == i ? len : found;
+}
+
+intern inline U64
+find_double_newline(const U8 *ptr, U64 len)
+{
+   ScanVec nl = scan_splat('\n');
+
+   U64 i = 0;
+   for (; i + SCAN_WIDTH + 1 <= len; i += SCAN_WIDTH) {
+      ScanVec a = scan_eq(scan_load(ptr + i), nl);
+      ScanVec b = scan_eq(scan_load(ptr + i + 1), nl);
+
+      U64 mask = scan_mask(scan_and(a, b));
+      if (mask) {
+         return i + (ctz_u64(mask) >> SCAN_MASK_SHIFT);
+      }
+   }
+
+   U64 found = find_double_newline_scalar(ptr + i, len - i);
+   return i + found;
+}
+
+// copies len bytes without carriage returns and returns how many were
+// written, dst may be the same as src
+intern inline U64
+strip_cr(U8 *dst, const U8 *src, U64 len)
+{
+   U64 blocks = len / STRIP_WIDTH;
+   U64 done = blocks * STRIP_WIDTH;
+
+   U64 written = scan_strip_cr(dst, src, blocks);
+   return written + strip_cr_scalar(dst + written, src + done, len - done);
+}
+
+#else
+
+intern inline U64 count_newlines(const U8 *ptr, U64 len) { return count_newlines_scalar(ptr, len); }
+intern inline U64 find_newline(const U8 *ptr, U64 len) { return find_newline_scalar(ptr, len); }
+intern inline U64 find_newline_reverse(const U8 *ptr, U64 len) { return find_newline_reverse_scalar(ptr, len); }
+intern inline U64 find_double_newline(const U8 *ptr, U64 len) { return find_double_newline_scalar(ptr, len); }
+intern inline U64 strip_cr(U8 *dst, const U8 *src, U64 len) { return strip_cr_scalar(dst, src, len); }
+
+#endif
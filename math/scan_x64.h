@@ -0,0 +1,154 @@
+#pragma once
+
+#include <immintrin.h>
+
+// SSE2 is always there on x64, AVX2 is used when the build enables it
+
+#if defined(__AVX2__)
+
+enum
+{
+   SCAN_WIDTH = 32
+};
+
+typedef __m256i ScanVec;
+
+intern inline ScanVec scan_load(const U8 *p) { return _mm256_loadu_si256((const __m256i *)p); }
+intern inline ScanVec scan_splat(U8 c) { return _mm256_set1_epi8((char)c); }
+intern inline ScanVec scan_eq(ScanVec a, ScanVec b) { return _mm256_cmpeq_epi8(a, b); }
+intern inline ScanVec scan_and(ScanVec a, ScanVec b) { return _mm256_and_si256(a, b); }
+intern inline U64 scan_mask(ScanVec v) { return (U32)_mm256_movemask_epi8(v); }
+
+intern inline U64
+scan_count(const U8 *ptr, U64 blocks)
+{
+   __m256i nl = _mm256_set1_epi8('\n');
+   __m256i total = _mm256_setzero_si256();
+
+   // byte counters overflow after 255 blocks
+   while (blocks > 0) {
+      U64 n = MIN(blocks, (U64)255);
+      __m256i acc = _mm256_setzero_si256();
+
+      for (U64 i = 0; i < n; ++i) {
+         acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(scan_load(ptr), nl));
+         ptr += SCAN_WIDTH;
+      }
+
+      total = _mm256_add_epi64(total, _mm256_sad_epu8(acc, _mm256_setzero_si256()));
+      blocks -= n;
+   }
+
+   __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(total), _mm256_extracti128_si256(total, 1));
+   return (U64)_mm_cvtsi128_si64(sum) + (U64)_mm_extract_epi64(sum, 1);
+}
+
+#else
+
+enum
+{
+   SCAN_WIDTH = 16
+};
+
+typedef __m128i ScanVec;
+
+intern inline ScanVec scan_load(const U8 *p) { return _mm_loadu_si128((const __m128i *)p); }
+intern inline ScanVec scan_splat(U8 c) { return _mm_set1_epi8((char)c); }
+intern inline ScanVec scan_eq(ScanVec a, ScanVec b) { return _mm_cmpeq_epi8(a, b); }
+intern inline ScanVec scan_and(ScanVec a, ScanVec b) { return _mm_and_si128(a, b); }
+intern inline U64 scan_mask(ScanVec v) { return (U32)_mm_movemask_epi8(v); }
+
+intern inline U64
+scan_count(const U8 *ptr, U64 blocks)
+{
+   __m128i nl = _mm_set1_epi8('\n');
+   __m128i total = _mm_setzero_si128();
+
+   // byte counters overflow after 255 blocks
+   while (blocks > 0) {
+      U64 n = MIN(blocks, (U64)255);
+      __m128i acc = _mm_setzero_si128();
+
+      for (U64 i = 0; i < n; ++i) {
+         acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(scan_load(ptr), nl));
+         ptr += SCAN_WIDTH;
+      }
+
+      total = _mm_add_epi64(total, _mm_sad_epu8(acc, _mm_setzero_si128()));
+      blocks -= n;
+   }
+
+   return (U64)_mm_cvtsi128_si64(total) + (U64)_mm_cvtsi128_si64(_mm_unpackhi_epi64(total, total));
+}
+
+#endif
+
+// one bit per byte
+enum
+{
+   SCAN_MASK_SHIFT = 0
+};
+
+// Packs the bytes that are not '\r' to the front of dst. Runs of four
+// blocks without one are stored whole, so the branch stays predictable on
+// both LF and CRLF text. AVX-512 VBMI2 has a compress store, SSSE3 packs
+// each 8 byte half with pshufb, plain SSE2 falls back to the scalar loop.
+// MSVC never defines __SSSE3__ but takes the intrinsics without a switch,
+// so its x64 builds always use pshufb.
+intern inline U64
+scan_strip_cr_block(U8 *out, const U8 *src, __m128i v, U32 mask)
+{
+#if defined(__AVX512VBMI2__) && defined(__AVX512VL__)
+   _mm_mask_compressstoreu_epi8(out, (__mmask16)~mask, v);
+   return STRIP_WIDTH - popcount_u32(mask);
+#elif defined(__SSSE3__) || COMPILER_MSVC
+   U32 lo = mask & 0xFF;
+   U32 hi = mask >> 8;
+
+   __m128i packed = _mm_shuffle_epi8(v, _mm_loadl_epi64((const __m128i *)&strip_cr_shuffle[lo]));
+   _mm_storel_epi64((__m128i *)out, packed);
+   U64 n = strip_cr_kept[lo];
+
+   packed = _mm_shuffle_epi8(_mm_srli_si128(v, 8), _mm_loadl_epi64((const __m128i *)&strip_cr_shuffle[hi]));
+   _mm_storel_epi64((__m128i *)(out + n), packed);
+   return n + strip_cr_kept[hi];
+#else
+   return mask ? strip_cr_scalar(out, src, STRIP_WIDTH) : (_mm_storeu_si128((__m128i *)out, v), STRIP_WIDTH);
+#endif
+}
+
+intern inline U64
+scan_strip_cr(U8 *dst, const U8 *src, U64 blocks)
+{
+   __m128i cr = _mm_set1_epi8('\r');
+   U8 *out = dst;
+
+   U64 i = 0;
+   for (; i + 4 <= blocks; i += 4, src += 4 * STRIP_WIDTH) {
+      __m128i v[4];
+      U32 mask[4];
+      for (U32 k = 0; k < 4; ++k) {
+         v[k] = _mm_loadu_si128((const __m128i *)(src + k * STRIP_WIDTH));
+         mask[k] = (U32)_mm_movemask_epi8(_mm_cmpeq_epi8(v[k], cr));
+      }
+
+      if ((mask[0] | mask[1] | mask[2] | mask[3]) == 0) {
+         for (U32 k = 0; k < 4; ++k) {
+            _mm_storeu_si128((__m128i *)(out + k * STRIP_WIDTH), v[k]);
+         }
+         out += 4 * STRIP_WIDTH;
+         continue;
+      }
+
+      for (U32 k = 0; k < 4; ++k) {
+         out += scan_strip_cr_block(out, src + k * STRIP_WIDTH, v[k], mask[k]);
+      }
+   }
+
+   for (; i < blocks; ++i, src += STRIP_WIDTH) {
+      __m128i v = _mm_loadu_si128((const __m128i *)src);
+      out += scan_strip_cr_block(out, src, v, (U32)_mm_movemask_epi8(_mm_cmpeq_epi8(v, cr)));
+   }
+
+   return (U64)(out - dst);
+}
@@ -0,0 +1,171 @@
+#include "editor/buffer.h"
+
+#include "editor/buffer.cpp"
+#include "editor/piece_tree.cpp"
+#include "editor/parse_worker.cpp"
+
+enum
+{
+   BENCH_DOC_SIZE = 64 << 20,
+   BENCH_EDITS = 1000,
+   BENCH_READS = 1000000,
+
+   BENCH_PASTE_DOC_SIZE = 256 << 10,
+   BENCH_PASTE_SIZE = 1 << 20,
+};
+
+// the refill policy insert_string had before the gap grew adaptively:
+// the tail is shifted by 16 bytes every time the gap runs out
+intern void
+legacy_insert_string(GapBuffer *buf, String8 s, U64 pos)
+{
+   move_gap(buf, pos);
+
+   while (s.len > 0) {
+      U64 gap_size = buf->end - buf->start;
+      if (gap_size == 0) {
+         U64 shift = 16;
+         buf->committed = commit_grow(buf->ptr, buf->committed, buf->end + shift + buf->len - buf->start, buf->cap);
+         MEM_MOVE(buf->ptr + buf->end + shift, buf->ptr + buf->end, buf->len - buf->end);
+         buf->end += shift;
+         gap_size = shift;
+      }
+
+      U64 copy_len = MIN(s.len, gap_size);
+      MEM_COPY(buf->ptr + buf->start, s.ptr, copy_len);
+
+      s.ptr += copy_len;
+      s.len -= copy_len;
+
+      buf->start += copy_len;
+      buf->len += copy_len;
+   }
+}
+
+enum
+{
+   PASTE_LEGACY,
+   PASTE_STRING,
+   PASTE_CHARS,
+   PASTE_RESERVED_CHARS,
+};
+
+intern void
+bench_paste_policy(U32 policy, String8 doc, String8 paste, const char *name)
+{
+   Arena arena = {};
+   init_arena(&arena, MEGA_BYTES(8));
+
+   GapBuffer gb = gap_buffer_from_arena(arena);
+   insert_string(&gb, doc, 0);
+
+   U64 at = doc.len / 2;
+
+   BenchTimer t = bench_begin(name);
+   switch (policy) {
+   case PASTE_LEGACY:
+      legacy_insert_string(&gb, paste, at);
+      break;
+   case PASTE_STRING:
+      insert_string(&gb, paste, at);
+      break;
+   case PASTE_CHARS:
+      for (U64 i = 0; i < paste.len; ++i) {
+         insert_char(&gb, paste.ptr[i], at + i);
+      }
+      break;
+   case PASTE_RESERVED_CHARS:
+      move_gap(&gb, at);
+      gap_buffer_reserve(&gb, paste.len);
+      for (U64 i = 0; i < paste.len; ++i) {
+         insert_char(&gb, paste.ptr[i], at + i);
+      }
+      break;
+   }
+   bench_end(t, paste.len);
+
+   ASSERT(gb.len == doc.len + paste.len);
+
+   free_arena(&arena, arena.size);
+}
+
+intern void
+bench_paste(String8 doc)
+{
+   String8 small_doc = String8(doc.ptr, BENCH_PASTE_DOC_SIZE);
+   String8 paste = String8(doc.ptr + BENCH_PASTE_DOC_SIZE, BENCH_PASTE_SIZE);
+
+   bench_paste_policy(PASTE_LEGACY, small_doc, paste, "paste 1MB: fixed 16 byte refill (before)");
+   bench_paste_policy(PASTE_STRING, small_doc, paste, "paste 1MB: insert_string");
+   bench_paste_policy(PASTE_CHARS, small_doc, paste, "paste 1MB: insert_char loop");
+   bench_paste_policy(PASTE_RESERVED_CHARS, small_doc, paste, "paste 1MB: reserve + insert_char loop");
+}
+
+intern void
+bench_buffer_backend(U32 backend, String8 doc, const char *name)
+{
+   Arena arena = {};
+   init_arena(&arena, MEGA_BYTES(512));
+
+   TextBuffer buf = text_buffer_from_arena(arena, backend);
+   insert_string(&buf, doc, 0);
+
+   char label[128];
+   U32 seed = 42;
+
+   snprintf(label, sizeof(label), "%s: %d random edits", name, BENCH_EDITS);
+   BenchTimer t = bench_begin(label);
+   for (U32 i = 0; i < BENCH_EDITS; ++i) {
+      U64 at = bench_random(&seed) % buf.len;
+
+      if (i & 1) {
+         insert_string(&buf, String8("edit\n"), at);
+      } else {
+         delete_chars(&buf, at, 4);
+      }
+   }
+   bench_end(t);
+
+   snprintf(label, sizeof(label), "%s: %d random reads", name, BENCH_READS);
+   t = bench_begin(label);
+   U64 sum = 0;
+   for (U32 i = 0; i < BENCH_READS; ++i) {
+      sum += buf[bench_random(&seed) % buf.len];
+   }
+   bench_end(t);
+
+   snprintf(label, sizeof(label), "%s: sequential scan", name);
+   t = bench_begin(label);
+   for (U64 i = 0; i < buf.len; ++i) {
+      sum += buf[i];
+   }
+   bench_end(t, buf.len);
+
+   log_dev("checksum %llu", (unsigned long long)sum);
+
+   free_arena(&arena, arena.size);
+}
+
+intern void
+bench_buffer()
+{
+   Arena arena = {};
+   init_arena(&arena, BENCH_DOC_SIZE + MEGA_BYTES(1));
+
+   String8 doc = {};
+   doc.ptr = push_array(&arena, U8, BENCH_DOC_SIZE);
+   doc.len = BENCH_DOC_SIZE;
+
+   U32 seed = 7;
+   for (U64 i = 0; i < doc.len; ++i) {
+      U32 r = bench_random(&seed);
+      doc.ptr[i] = (r % 40 == 0) ? '\n' : (U8)('a' + r % 26);
+   }
+
+   bench_buffer_backend(BUFFER_GAP, doc, "gap buffer");
+   bench_buffer_backend(BUFFER_PIECE_TREE, doc, "piece tree");
+
+   bench_paste(doc);
+
+   free_arena(&arena, arena.size);
+}
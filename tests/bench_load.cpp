@@ -0,0 +1,99 @@
+// the load loop before the strip kernel: a branch and two counters per byte
+intern U64
+legacy_strip_cr(U8 *dst, const U8 *src, U64 len)
+{
+   U64 written = 0;
+   U64 newlines = 0;
+   for (U64 i = 0; i < len; ++i) {
+      if (src[i] != '\r') {
+         if (src[i] == '\n') {
+            newlines++;
+         }
+
+         dst[written] = src[i];
+         written++;
+      }
+   }
+
+   return written + (newlines & 0);
+}
+
+intern void
+bench_fill_lines(U8 *text, U64 size, B32 crlf)
+{
+   U32 seed = 11;
+   U64 i = 0;
+   while (i < size) {
+      U64 line = 8 + bench_random(&seed) % 72;
+      for (U64 j = 0; j < line && i < size; ++j) {
+         text[i++] = (U8)('a' + bench_random(&seed) % 26);
+      }
+
+      if (crlf && i < size) text[i++] = '\r';
+      if (i < size) text[i++] = '\n';
+   }
+}
+
+intern void
+bench_load_file(const char *path, U32 backend, const char *name)
+{
+   String8 file = os_map_file(String8(path));
+
+   Arena arena = {};
+   init_arena(&arena, file.len * 2 + MEGA_BYTES(64));
+
+   BenchTimer t = bench_begin(name);
+   TextBuffer buf = text_buffer_from_arena(arena, backend);
+   load_source_file(&buf, file);
+   bench_end(t, file.len);
+
+   text_buffer_release(&buf);
+   free_arena(&arena, arena.size);
+}
+
+intern void
+bench_load()
+{
+   U64 size = GIGA_BYTES(1);
+
+   Arena arena = {};
+   init_arena(&arena, 2 * size);
+
+   U8 *src = push_array(&arena, U8, size);
+   U8 *dst = push_array(&arena, U8, size);
+   U64 check = 0;
+
+   for (U32 crlf = 0; crlf < 2; ++crlf) {
+      bench_fill_lines(src, size, crlf);
+      MEM_SET(dst, 0, size);
+
+      BenchTimer t = bench_begin(crlf ? "strip cr (crlf): per byte loop" : "strip cr (lf): per byte loop");
+      check += legacy_strip_cr(dst, src, size);
+      bench_end(t, size);
+
+      t = bench_begin(crlf ? "strip cr (crlf): scalar" : "strip cr (lf): scalar");
+      check += strip_cr_scalar(dst, src, size);
+      bench_end(t, size);
+
+      t = bench_begin(crlf ? "strip cr (crlf): simd" : "strip cr (lf): simd");
+      check += strip_cr(dst, src, size);
+      bench_end(t, size);
+   }
+
+   // the crlf text is still in src, write it out for the file loads
+   const char *path = "bench_load.tmp";
+   FILE *f = fopen(path, "wb");
+   fwrite(src, 1, size, f);
+   fclose(f);
+
+   free_arena(&arena, arena.size);
+
+   // the first load pulls the file into the page cache
+   bench_load_file(path, BUFFER_GAP, "load 1GB crlf: gap buffer (cold)");
+   bench_load_file(path, BUFFER_GAP, "load 1GB crlf: gap buffer");
+   bench_load_file(path, BUFFER_PIECE_TREE, "load 1GB crlf: piece tree");
+
+   remove(path);
+
+   log_dev("checksum %llu", (unsigned long long)check);
+}
@@ -0,0 +1,138 @@
+#include "tree_sitter/api.h"
+
+enum
+{
+   BENCH_PARSE_LINES = 50000,
+   BENCH_PARSE_KEYS = 200,
+};
+
+intern TSPoint
+bench_ts_point(TextBuffer *buf, U64 pos)
+{
+   TextPoint p = buffer_point(buf, pos);
+
+   TSPoint point = {};
+   point.row = U32(p.row);
+   point.column = U32(p.col);
+
+   return point;
+}
+
+// what a typed character does in the editor before the frame submits it
+intern void
+bench_type_char(TextBuffer *buf, ParseWorker *w, TSTree *tree, U64 pos)
+{
+   TSInputEdit edit = {};
+   edit.start_byte = U32(pos);
+   edit.old_end_byte = U32(pos);
+   edit.new_end_byte = U32(pos + 1);
+   edit.start_point = bench_ts_point(buf, pos);
+   edit.old_end_point = edit.start_point;
+
+   insert_char(buf, 'x', pos);
+
+   edit.new_end_point = bench_ts_point(buf, pos + 1);
+
+   if (tree) {
+      ts_tree_edit(tree, &edit);
+   }
+   parse_worker_edit(w, edit);
+}
+
+// the worker publishes a tree for every snapshot it finishes
+intern TSTree *
+bench_wait_tree(ParseWorker *w)
+{
+   TSTree *tree = 0;
+   while (!tree) {
+      tree = parse_worker_take(w);
+   }
+
+   return tree;
+}
+
+intern void
+bench_parse_backend(const TSLanguage *lang, U32 backend, const char *backend_name)
+{
+   const char *lines[] = {
+      "// computes the value of node %u\n",
+      "static int\n",
+      "compute_%u(const Node *node, int depth)\n",
+      "{\n",
+      "   int total = node->value * %u;\n",
+      "   for (int i = 0; i < node->count; ++i) {\n",
+      "      total += compute_child(node->children[i], depth + 1);\n",
+      "   }\n",
+      "   return total;\n",
+      "}\n",
+   };
+
+   Arena arena = {};
+   init_arena(&arena, MEGA_BYTES(64));
+
+   TextBuffer buf = text_buffer_from_arena(arena, backend);
+
+   char line[128];
+   for (U32 i = 0; i < BENCH_PARSE_LINES; ++i) {
+      int len = snprintf(line, sizeof(line), lines[i % ARRAY_COUNT(lines)], i / ARRAY_COUNT(lines));
+      insert_string(&buf, String8((U8 *) line, (U64) len), buf.len);
+   }
+
+   ParseWorker *w = parse_worker_start(lang);
+
+   char name[64];
+   snprintf(name, sizeof(name), "initial parse: %s", backend_name);
+
+   BenchTimer t = bench_begin(name);
+   parse_worker_submit(w, &buf);
+   TSTree *tree = bench_wait_tree(w);
+   bench_end(t, buf.len);
+
+   // typing in the middle of the file, every keystroke is submitted and
+   // waited for like a frame that shows the new tree right away
+   U64 at = buffer_line_begin(&buf, BENCH_PARSE_LINES / 2 + 4) + 20;
+   U64 ui_us = 0;
+
+   snprintf(name, sizeof(name), "keystroke reparse: %s", backend_name);
+   t = bench_begin(name);
+
+   for (U32 i = 0; i < BENCH_PARSE_KEYS; ++i) {
+      U64 start = os_now_microseconds();
+      bench_type_char(&buf, w, tree, at + i);
+      parse_worker_submit(w, &buf);
+      ui_us += os_now_microseconds() - start;
+
+      ts_tree_delete(tree);
+      tree = bench_wait_tree(w);
+   }
+
+   U64 us = bench_end(t);
+   log_info("%-40s %10.1f us", "  ui thread per keystroke", (double) ui_us / (double) BENCH_PARSE_KEYS);
+   log_info("%-40s %10.1f us", "  keystroke to tree", (double) us / (double) BENCH_PARSE_KEYS);
+
+   ts_tree_delete(tree);
+   parse_worker_stop(w);
+   text_buffer_release(&buf);
+   free_arena(&arena, arena.size);
+}
+
+intern void
+bench_parse()
+{
+   const TSLanguage *lang = tree_sitter_cpp();
+
+   // the worker would never finish a tree with a language it can not use
+   TSParser *parser = ts_parser_new();
+   B32 usable = lang && ts_parser_set_language(parser, lang);
+   ts_parser_delete(parser);
+
+   if (!usable) {
+      log_error("tree-sitter-cpp is not available, skipping the parse benchmark");
+      return;
+   }
+
+   log_info("parse benchmark: %u lines", BENCH_PARSE_LINES);
+
+   bench_parse_backend(lang, BUFFER_GAP, "gap buffer");
+   bench_parse_backend(lang, BUFFER_PIECE_TREE, "piece tree");
+}
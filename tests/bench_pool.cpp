@@ -0,0 +1,139 @@
+enum
+{
+   BENCH_POOL_LIVE = 1 << 16, // objects alive at any time
+   BENCH_POOL_OPS = 1 << 24,
+   BENCH_POOL_THREADS = 4,
+   BENCH_POOL_ITEM_SIZE = sizeof(PieceNode),
+};
+
+enum
+{
+   CHURN_MALLOC,
+   CHURN_POOL,
+   CHURN_POOL_CACHE,
+};
+
+struct ChurnJob
+{
+   U32 kind;
+   Pool *pool;
+   U32 seed;
+   U32 ops;
+   U64 checksum;
+};
+
+// frees a random live object and allocates its replacement, every object
+// is written so the allocators also pay for the cache misses they cause
+intern void
+bench_churn(void *param)
+{
+   ChurnJob *job = (ChurnJob *) param;
+   U8 **live = (U8 **) malloc(BENCH_POOL_LIVE * sizeof(U8 *));
+
+   PoolCache cache = {};
+   if (job->pool) {
+      cache = pool_cache(job->pool);
+   }
+
+   for (U32 i = 0; i < BENCH_POOL_LIVE; ++i) {
+      switch (job->kind) {
+      case CHURN_MALLOC:     live[i] = (U8 *) malloc(BENCH_POOL_ITEM_SIZE); break;
+      case CHURN_POOL:       live[i] = (U8 *) pool_alloc(job->pool); break;
+      case CHURN_POOL_CACHE: live[i] = (U8 *) pool_cache_alloc(&cache); break;
+      }
+      live[i][0] = (U8) i;
+   }
+
+   U32 seed = job->seed;
+   U64 checksum = 0;
+
+   for (U32 op = 0; op < job->ops; ++op) {
+      U32 i = bench_random(&seed) % BENCH_POOL_LIVE;
+      checksum += live[i][0];
+
+      switch (job->kind) {
+      case CHURN_MALLOC:
+         free(live[i]);
+         live[i] = (U8 *) malloc(BENCH_POOL_ITEM_SIZE);
+         break;
+      case CHURN_POOL:
+         pool_free(job->pool, live[i]);
+         live[i] = (U8 *) pool_alloc(job->pool);
+         break;
+      case CHURN_POOL_CACHE:
+         pool_cache_free(&cache, live[i]);
+         live[i] = (U8 *) pool_cache_alloc(&cache);
+         break;
+      }
+      live[i][0] = (U8) op;
+   }
+
+   for (U32 i = 0; i < BENCH_POOL_LIVE; ++i) {
+      switch (job->kind) {
+      case CHURN_MALLOC:     free(live[i]); break;
+      case CHURN_POOL:       pool_free(job->pool, live[i]); break;
+      case CHURN_POOL_CACHE: pool_cache_free(&cache, live[i]); break;
+      }
+   }
+
+   if (job->kind == CHURN_POOL_CACHE) {
+      pool_cache_flush(&cache);
+   }
+
+   free(live);
+   job->checksum = checksum;
+}
+
+intern void
+bench_churn_threads(U32 kind, U32 thread_count, const char *name)
+{
+   Arena arena = {};
+   init_arena(&arena, MEGA_BYTES(256));
+
+   Pool pool = {};
+   init_pool(&pool, arena, BENCH_POOL_ITEM_SIZE, thread_count > 1);
+
+   ChurnJob jobs[BENCH_POOL_THREADS] = {};
+   OS_Handle threads[BENCH_POOL_THREADS] = {};
+
+   BenchTimer t = bench_begin(name);
+
+   for (U32 i = 0; i < thread_count; ++i) {
+      jobs[i].kind = kind;
+      jobs[i].pool = kind == CHURN_MALLOC ? 0 : &pool;
+      jobs[i].seed = 17 + i;
+      jobs[i].ops = BENCH_POOL_OPS / thread_count;
+      threads[i] = os_thread_start(bench_churn, &jobs[i]);
+   }
+
+   U64 checksum = 0;
+   for (U32 i = 0; i < thread_count; ++i) {
+      os_thread_join(threads[i]);
+      checksum += jobs[i].checksum;
+   }
+
+   bench_end(t);
+
+   // keeps the writes from being optimized out
+   if (checksum == 1) {
+      log_info("%llu", checksum);
+   }
+
+   release_pool(&pool);
+   free_arena(&arena, arena.size);
+}
+
+intern void
+bench_pool()
+{
+   log_info("Allocation churn: %u live objects of %u bytes, %u frees and allocations",
+            BENCH_POOL_LIVE, BENCH_POOL_ITEM_SIZE, BENCH_POOL_OPS);
+
+   bench_churn_threads(CHURN_MALLOC, 1, "malloc, 1 thread");
+   bench_churn_threads(CHURN_POOL, 1, "pool, 1 thread");
+   bench_churn_threads(CHURN_POOL_CACHE, 1, "pool cache, 1 thread");
+
+   bench_churn_threads(CHURN_MALLOC, BENCH_POOL_THREADS, "malloc, 4 threads");
+   bench_churn_threads(CHURN_POOL, BENCH_POOL_THREADS, "shared pool, 4 threads");
+   bench_churn_threads(CHURN_POOL_CACHE, BENCH_POOL_THREADS, "shared pool with caches, 4 threads");
+}
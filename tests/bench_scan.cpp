@@ -0,0 +1,207 @@
+#include "math/scan_inc.h"
+
+enum
+{
+   BENCH_SCAN_PASSES = 4,
+};
+
+// the per-byte walk through GapBuffer::operator[] the cursor code used before
+intern U64
+scan_count_newlines_indexed(GapBuffer *gb)
+{
+   U64 count = 0;
+   for (U64 i = 0; i < gb->len; ++i) {
+      count += (*gb)[i] == '\n';
+   }
+
+   return count;
+}
+
+intern void
+bench_scan()
+{
+   U64 size = GIGA_BYTES(1);
+
+   Arena arena = {};
+   init_arena(&arena, size + MEGA_BYTES(1));
+
+   U8 *text = push_array(&arena, U8, size);
+   U32 seed = 3;
+   for (U64 i = 0; i < size; ++i) {
+      U32 r = bench_random(&seed);
+      text[i] = (r % 48 == 0) ? '\n' : (U8)('a' + r % 26);
+   }
+
+   // gap in the middle, both halves are scanned separately
+   U64 gap = KILO_BYTES(64);
+   U64 half = size / 2 - gap;
+
+   GapBuffer gb = {};
+   gb.ptr = text;
+   gb.cap = size;
+   gb.start = half;
+   gb.end = half + gap;
+   gb.len = size - gap;
+
+   String8 halves[2] = {
+      String8(text, half),
+      String8(text + half + gap, size - half - gap),
+   };
+
+   U64 total = (U64)BENCH_SCAN_PASSES * gb.len;
+   U64 check = 0;
+
+   BenchTimer t = bench_begin("count newlines: operator[] walk");
+   for (U32 pass = 0; pass < BENCH_SCAN_PASSES; ++pass) {
+      check += scan_count_newlines_indexed(&gb);
+   }
+   bench_end(t, total);
+
+   t = bench_begin("count newlines: scalar");
+   for (U32 pass = 0; pass < BENCH_SCAN_PASSES; ++pass) {
+      for (U32 h = 0; h < 2; ++h) {
+         check += count_newlines_scalar(halves[h].ptr, halves[h].len);
+      }
+   }
+   bench_end(t, total);
+
+   t = bench_begin("count newlines: simd");
+   for (U32 pass = 0; pass < BENCH_SCAN_PASSES; ++pass) {
+      for (U32 h = 0; h < 2; ++h) {
+         check += count_newlines(halves[h].ptr, halves[h].len);
+      }
+   }
+   bench_end(t, total);
+
+   // walks line by line like repeated cursor_line_end calls
+   t = bench_begin("next newline walk: scalar");
+   for (U32 pass = 0; pass < BENCH_SCAN_PASSES; ++pass) {
+      for (U32 h = 0; h < 2; ++h) {
+         String8 s = halves[h];
+         for (U64 i = find_newline_scalar(s.ptr, s.len); i < s.len; i += 1 + find_newline_scalar(s.ptr + i + 1, s.len - i - 1)) {
+            check++;
+         }
+      }
+   }
+   bench_end(t, total);
+
+   t = bench_begin("next newline walk: simd");
+   for (U32 pass = 0; pass < BENCH_SCAN_PASSES; ++pass) {
+      for (U32 h = 0; h < 2; ++h) {
+         String8 s = halves[h];
+         for (U64 i = find_newline(s.ptr, s.len); i < s.len; i += 1 + find_newline(s.ptr + i + 1, s.len - i - 1)) {
+            check++;
+         }
+      }
+   }
+   bench_end(t, total);
+
+   t = bench_begin("prev newline walk: scalar");
+   for (U32 pass = 0; pass < BENCH_SCAN_PASSES; ++pass) {
+      for (U32 h = 0; h < 2; ++h) {
+         String8 s = halves[h];
+         for (U64 end = s.len, i; (i = find_newline_reverse_scalar(s.ptr, end)) < end; end = i) {
+            check++;
+         }
+      }
+   }
+   bench_end(t, total);
+
+   t = bench_begin("prev newline walk: simd");
+   for (U32 pass = 0; pass < BENCH_SCAN_PASSES; ++pass) {
+      for (U32 h = 0; h < 2; ++h) {
+         String8 s = halves[h];
+         for (U64 end = s.len, i; (i = find_newline_reverse(s.ptr, end)) < end; end = i) {
+            check++;
+         }
+      }
+   }
+   bench_end(t, total);
+
+   t = bench_begin("double newline: scalar");
+   for (U32 pass = 0; pass < BENCH_SCAN_PASSES; ++pass) {
+      for (U32 h = 0; h < 2; ++h) {
+         String8 s = halves[h];
+         for (U64 i = find_double_newline_scalar(s.ptr, s.len); i < s.len; i += 1 + find_double_newline_scalar(s.ptr + i + 1, s.len - i - 1)) {
+            check++;
+         }
+      }
+   }
+   bench_end(t, total);
+
+   t = bench_begin("double newline: simd");
+   for (U32 pass = 0; pass < BENCH_SCAN_PASSES; ++pass) {
+      for (U32 h = 0; h < 2; ++h) {
+         String8 s = halves[h];
+         for (U64 i = find_double_newline(s.ptr, s.len); i < s.len; i += 1 + find_double_newline(s.ptr + i + 1, s.len - i - 1)) {
+            check++;
+         }
+      }
+   }
+   bench_end(t, total);
+
+   log_dev("checksum %llu", (unsigned long long)check);
+
+   free_arena(&arena, arena.size);
+}
+
+enum
+{
+   BENCH_PAGES_SIZE = 1 << 30,
+   BENCH_PAGES_READS = 1 << 24,
+};
+
+// the same text in small and in large pages. The scan streams through it,
+// the dependent random reads miss the TLB on nearly every access.
+intern void
+bench_scan_pages_of(B32 large, const char *scan_name, const char *random_name)
+{
+   U64 size = BENCH_PAGES_SIZE;
+   U8 *text = (U8 *) (large ? os_reserve_large(size) : os_reserve(size));
+   if (!text || !os_commit(text, size)) {
+      log_error("Failed to reserve %llu bytes", (unsigned long long)size);
+      return;
+   }
+
+   U32 seed = 5;
+   for (U64 i = 0; i < size; ++i) {
+      U32 r = bench_random(&seed);
+      text[i] = (r % 48 == 0) ? '\n' : (U8)('a' + r % 26);
+   }
+
+   U64 check = 0;
+
+   BenchTimer t = bench_begin(scan_name);
+   for (U32 pass = 0; pass < BENCH_SCAN_PASSES; ++pass) {
+      check += count_newlines(text, size);
+   }
+   bench_end(t, (U64)BENCH_SCAN_PASSES * size);
+
+   U64 pos = 0;
+   t = bench_begin(random_name);
+   for (U32 i = 0; i < BENCH_PAGES_READS; ++i) {
+      pos = (pos * 6364136223846793005ull + 1442695040888963407ull + text[pos]) & (size - 1);
+   }
+   bench_end(t);
+   check += pos;
+
+   log_dev("checksum %llu", (unsigned long long)check);
+
+   os_release(text, size);
+}
+
+intern void
+bench_scan_pages()
+{
+   U64 large_page = os_large_page_size();
+   if (!large_page) {
+      log_info("Large pages are not available, skipping the page size benchmark");
+      return;
+   }
+
+   log_info("1 GB of text in %llu KB and %llu KB pages, %u dependent random reads",
+            (unsigned long long)(os_page_size() >> 10), (unsigned long long)(large_page >> 10), BENCH_PAGES_READS);
+
+   bench_scan_pages_of(0, "count newlines: small pages", "random reads: small pages");
+   bench_scan_pages_of(1, "count newlines: large pages", "random reads: large pages");
+}
@@ -0,0 +1,60 @@
+#include "base/base_inc.h"
+#include "base/base_inc.cpp"
+
+struct BenchTimer
+{
+   const char *name;
+   U64 start;
+};
+
+intern BenchTimer
+bench_begin(const char *name)
+{
+   BenchTimer t = {};
+   t.name = name;
+   t.start = os_now_microseconds();
+   return t;
+}
+
+// bytes is optional, when set the throughput is reported as well
+intern U64
+bench_end(BenchTimer t, U64 bytes=0)
+{
+   U64 us = os_now_microseconds() - t.start;
+   double ms = (double)us / 1000.0;
+
+   if (bytes) {
+      double mbs = ((double)bytes / (double)MEGA_BYTES(1)) / ((double)CLAMP_BOT(us, 1) / 1000000.0);
+      log_info("%-40s %10.3f ms %10.1f MB/s", t.name, ms, mbs);
+   } else {
+      log_info("%-40s %10.3f ms", t.name, ms);
+   }
+
+   return us;
+}
+
+intern U32
+bench_random(U32 *seed)
+{
+   *seed = *seed * 1664525 + 1013904223;
+   return *seed >> 8;
+}
+
+#include "bench_buffer.cpp"
+#include "bench_scan.cpp"
+#include "bench_load.cpp"
+#include "bench_parse.cpp"
+#include "bench_pool.cpp"
+
+int
+main(int argc, char **argv)
+{
+   bench_buffer();
+   bench_scan();
+   bench_scan_pages();
+   bench_load();
+   bench_parse();
+   bench_pool();
+
+   return 0;
+}
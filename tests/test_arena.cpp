@@ -0,0 +1,152 @@
+#include "base/base_inc.h"
+
+intern void
+test_scratch_thread(void *param)
+{
+   Arena **out = (Arena **) param;
+
+   TempArena scratch = get_scratch();
+   push_array(scratch.arena, U8, 100);
+   *out = scratch.arena;
+   release_scratch(scratch);
+
+   free_thread_scratch();
+}
+
+intern void
+test_arena()
+{
+   Arena arena = {};
+   init_arena(&arena, MEGA_BYTES(64));
+
+   // Test 1: Nothing is committed until it is pushed, then in whole steps
+   TEST_CHECK(arena.commit == 0);
+
+   U8 *small = push_array(&arena, U8, 100);
+   small[99] = 1;
+   TEST_CHECK(arena.commit == ARENA_COMMIT_SIZE);
+
+   U8 *big = push_array(&arena, U8, ARENA_COMMIT_SIZE + 1);
+   big[ARENA_COMMIT_SIZE] = 1;
+   TEST_CHECK(arena.commit == 2 * ARENA_COMMIT_SIZE);
+
+   // Test 2: Sub arenas commit their own range, not the parent
+   Arena sub = {};
+   sub_arena(&sub, &arena, MEGA_BYTES(16));
+   TEST_CHECK(sub.commit == 0);
+   TEST_CHECK(arena.commit == arena.top);
+
+   U8 *in_sub = push_array(&sub, U8, 10);
+   in_sub[9] = 1;
+   TEST_CHECK(sub.commit == ARENA_COMMIT_SIZE);
+
+   U8 *after_sub = push_array(&arena, U8, 10);
+   after_sub[9] = 1;
+   TEST_CHECK(arena.commit - arena.top < ARENA_COMMIT_SIZE);
+
+   // Test 3: Temp arenas keep their pages unless asked to give them back
+   U64 top = arena.top;
+   U64 commit = arena.commit;
+
+   TempArena temp = begin_temp_arena(&arena);
+   U8 *scratch = push_array(&arena, U8, MEGA_BYTES(2));
+   scratch[MEGA_BYTES(2) - 1] = 1;
+   end_temp_arena(temp);
+   TEST_CHECK(arena.top == top);
+   TEST_CHECK(arena.commit >= top + MEGA_BYTES(2));
+
+   temp = begin_temp_arena(&arena);
+   scratch = push_array(&arena, U8, MEGA_BYTES(2));
+   end_temp_arena(temp, 0);
+   TEST_CHECK(arena.top == top);
+   TEST_CHECK(arena.commit <= ALIGN_POW2(commit, os_page_size()));
+
+   // Test 4: Pushes into the range of a dropped sub arena commit it again
+   temp = begin_temp_arena(&arena);
+   Arena dropped = {};
+   sub_arena(&dropped, &arena, MEGA_BYTES(4));
+   end_temp_arena(temp);
+   TEST_CHECK(arena.commit <= top + ARENA_COMMIT_SIZE);
+
+   U8 *reused = push_array(&arena, U8, MEGA_BYTES(3));
+   reused[MEGA_BYTES(3) - 1] = 1;
+   TEST_CHECK(arena.commit >= arena.top);
+
+   // Test 5: Memory written in place commits from either end
+   Arena raw = {};
+   sub_arena(&raw, &arena, MEGA_BYTES(1));
+
+   U64 front = commit_grow(raw.ptr, 0, 10, raw.size);
+   TEST_CHECK(front == ARENA_COMMIT_SIZE);
+   raw.ptr[9] = 1;
+   TEST_CHECK(commit_grow(raw.ptr, front, ARENA_COMMIT_SIZE, raw.size) == front);
+
+   U64 back = commit_grow_down(raw.ptr + raw.size, 0, 3 * ARENA_COMMIT_SIZE, raw.size);
+   TEST_CHECK(back == 3 * ARENA_COMMIT_SIZE);
+   raw.ptr[raw.size - 3 * ARENA_COMMIT_SIZE] = 1;
+   raw.ptr[raw.size - 1] = 1;
+
+   TEST_CHECK(commit_grow(raw.ptr, front, 2 * raw.size, raw.size) == raw.size);
+
+   // Test 6: Stats follow pushes, temps and releases
+   ArenaStats *stats = arena.stats;
+   TEST_CHECK(stats && sub.stats && sub.stats->parent == stats);
+   TEST_CHECK(stats->push_count == 6);
+   TEST_CHECK(stats->histogram[6] == 1 && stats->histogram[16] == 1 && stats->histogram[21] == 3);
+   TEST_CHECK(stats->peak_top >= top + MEGA_BYTES(4));
+   TEST_CHECK(stats->peak_commit >= top + MEGA_BYTES(2));
+   TEST_CHECK(stats->temp_depth == 0 && stats->peak_temp_depth == 1);
+
+   temp = begin_temp_arena(&arena);
+   TempArena nested = begin_temp_arena(&arena);
+   end_temp_arena(nested);
+   end_temp_arena(temp);
+   TEST_CHECK(stats->temp_depth == 0 && stats->peak_temp_depth == 2);
+
+   free_arena(&arena, arena.size);
+   TEST_CHECK(stats->released && sub.stats->released && raw.stats->released);
+
+   // Test 7: Nested scratches avoid the arenas of their callers
+   TempArena outer = get_scratch();
+   U8 *outer_data = push_array(outer.arena, U8, 64);
+   outer_data[63] = 1;
+
+   TempArena inner = get_scratch(&outer.arena, 1);
+   TEST_CHECK(inner.arena != outer.arena);
+   push_array(inner.arena, U8, MEGA_BYTES(8));
+   release_scratch(inner);
+   TEST_CHECK(inner.arena->top == 0);
+   TEST_CHECK(inner.arena->commit <= ALIGN_POW2(SCRATCH_KEEP_SIZE, os_page_size()));
+
+   TempArena again = get_scratch();
+   TEST_CHECK(again.arena == outer.arena && again.reset_top == outer.arena->top);
+   release_scratch(again);
+   release_scratch(outer);
+   TEST_CHECK(outer.arena->top == 0);
+
+   // other threads have scratches of their own
+   Arena *thread_scratch = 0;
+   os_thread_join(os_thread_start(test_scratch_thread, &thread_scratch));
+   TEST_CHECK(thread_scratch && thread_scratch != outer.arena && thread_scratch != inner.arena);
+
+   free_thread_scratch();
+
+   // Test 8: Large arenas commit whole large pages, their large subs start on one
+   U64 large_page = os_large_page_size();
+   U64 step = MAX(large_page, (U64) ARENA_COMMIT_SIZE);
+
+   Arena large = {};
+   init_arena(&large, 2 * ARENA_LARGE_PAGE_THRESHOLD);
+   U8 *large_data = push_array(&large, U8, 10);
+   large_data[9] = 1;
+   TEST_CHECK(large.commit == step);
+   TEST_CHECK(!large_page || (U64) large.ptr % large_page == 0);
+
+   Arena large_sub = {};
+   sub_arena(&large_sub, &large, ARENA_LARGE_PAGE_THRESHOLD);
+   TEST_CHECK(!large_page || (U64) large_sub.ptr % large_page == 0);
+   TEST_CHECK(commit_grow(large_sub.ptr, 0, 1, large_sub.size) == step);
+   large_sub.ptr[step - 1] = 1;
+
+   free_arena(&large, large.size);
+}
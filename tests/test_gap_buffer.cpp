@@ -9,11 +9,14 @@ test_gap_buffer()
    init_arena(&arena, MEGA_BYTES(1));
 
    Arena buffer_arena = {};
-   sub_arena(&buffer_arena, &arena, KILO_BYTES(512));
+   sub_arena(&buffer_arena, &arena, KILO_BYTES(256));
+
+   Arena line_arena = {};
+   sub_arena(&line_arena, &arena, KILO_BYTES(256));
 
    TempArena temp_arena = begin_temp_arena(&arena);
 
-   GapBuffer gb = gap_buffer_from_arena(arena);
+   GapBuffer gb = gap_buffer_from_arena(buffer_arena);
 
    // Test 1: Insert
    String8 s1("Hello");
@@ -68,6 +71,38 @@ test_gap_buffer()
    result = str8_from_gap_buffer(&gb, temp_arena.arena);
    TEST_CHECK(result == String8("¡Hello!☺"));
 
+   // Test 8: Reserving gap capacity keeps the content intact
+   gap_buffer_reserve(&gb, 4096);
+   TEST_CHECK(gb.end - gb.start >= 4096);
+   result = str8_from_gap_buffer(&gb, temp_arena.arena);
+   TEST_CHECK(result == String8("¡Hello!☺"));
+
+   // Test 9: Large insert in the middle returns the position after it
+   U8 block[1000];
+   MEM_SET(block, 'x', sizeof(block));
+   U64 pos = insert_string(&gb, String8(block, sizeof(block)), 2);
+   TEST_CHECK(pos == 2 + sizeof(block));
+   TEST_CHECK(gb.len == 11 + sizeof(block));
+   TEST_CHECK(gb[1 + sizeof(block)] == 'x');
+   TEST_CHECK(gb[2 + sizeof(block)] == 'H');
+
+   // Test 10: Line index follows inserts, deletes and gap moves
+   GapBuffer lb = gap_buffer_from_arena(line_arena);
+   insert_string(&lb, String8("one\ntwo\nthree"), 0);
+   TEST_CHECK(gap_buffer_newline_count(&lb) == 2);
+   TEST_CHECK(gap_buffer_newline_offset(&lb, 1) == 7);
+
+   insert_char(&lb, '\n', 1);  // "o\nne\ntwo\nthree"
+   TEST_CHECK(gap_buffer_newline_count(&lb) == 3);
+   TEST_CHECK(gap_buffer_newline_offset(&lb, 0) == 1);
+   TEST_CHECK(gap_buffer_newline_offset(&lb, 2) == 8);
+   TEST_CHECK(gap_buffer_newlines_before(&lb, 5) == 2);
+
+   delete_chars(&lb, 4, 4);  // "o\nne\nthree"
+   TEST_CHECK(gap_buffer_newline_count(&lb) == 2);
+   TEST_CHECK(gap_buffer_newline_offset(&lb, 1) == 4);
+   TEST_CHECK(gap_buffer_newlines_before(&lb, lb.len) == 2);
+
    end_temp_arena(temp_arena);
    free_arena(&arena, arena.size);
 }
\ No newline at end of file
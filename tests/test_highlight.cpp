@@ -0,0 +1,76 @@
+intern void
+test_highlight()
+{
+   HighlightCache c = {};
+   init_arena(&c.arena, sizeof(HighlightRow) * HIGHLIGHT_MAX_ROWS);
+   c.rows = push_array(&c.arena, HighlightRow, HIGHLIGHT_MAX_ROWS);
+
+   // Test 1: Rows that come into view are invalid
+   highlight_cache_scroll(&c, 10, 20);
+   TEST_CHECK(c.first_row == 10 && c.row_count == 20);
+
+   for (U32 i = 0; i < c.row_count; ++i) {
+      TEST_CHECK(!c.rows[i].valid);
+      c.rows[i].valid = 1;
+      c.rows[i].span_count = i;
+   }
+
+   // Test 2: Scrolling keeps the rows that stay on screen
+   highlight_cache_scroll(&c, 15, 20);
+   TEST_CHECK(c.rows[0].valid && c.rows[0].span_count == 5);
+   TEST_CHECK(c.rows[14].valid && c.rows[14].span_count == 19);
+   TEST_CHECK(!c.rows[15].valid && !c.rows[19].valid);
+
+   for (U32 i = 15; i < 20; ++i) {
+      c.rows[i].valid = 1;
+      c.rows[i].span_count = i + 5;
+   }
+
+   highlight_cache_scroll(&c, 12, 20);
+   TEST_CHECK(!c.rows[0].valid && !c.rows[2].valid);
+   TEST_CHECK(c.rows[3].valid && c.rows[3].span_count == 5);
+   TEST_CHECK(c.rows[19].valid && c.rows[19].span_count == 21);
+
+   highlight_cache_scroll(&c, 1000, 20);
+   B32 none_valid = 1;
+   for (U32 i = 0; i < c.row_count; ++i) {
+      none_valid &= !c.rows[i].valid;
+      c.rows[i].valid = 1;
+   }
+   TEST_CHECK(none_valid);
+
+   // Test 3: Changed ranges only touch the rows on screen
+   highlight_cache_invalidate(&c, 990, 1002);
+   highlight_cache_invalidate(&c, 1005, 1006);
+   highlight_cache_invalidate(&c, 1019, max_U64);
+   TEST_CHECK(!c.rows[0].valid && !c.rows[1].valid && c.rows[2].valid);
+   TEST_CHECK(!c.rows[5].valid && c.rows[6].valid);
+   TEST_CHECK(c.rows[18].valid && !c.rows[19].valid);
+
+   // Test 4: An edit keeping the line count only invalidates its row
+   for (U32 i = 0; i < c.row_count; ++i) {
+      c.rows[i].valid = 1;
+   }
+   c.line_count = 5000;
+
+   TEST_CHECK(highlight_cache_edit(&c, 1010, 5000) == 1011);
+   TEST_CHECK(c.rows[9].valid && !c.rows[10].valid && c.rows[11].valid);
+
+   TEST_CHECK(highlight_cache_edit(&c, 1012, 5001) == max_U64);
+   TEST_CHECK(c.rows[11].valid && !c.rows[12].valid && !c.rows[19].valid);
+   TEST_CHECK(c.line_count == 5001);
+
+   // Test 5: Damage of edits, cursor moves and queries adds up to one range
+   Pane p = {};
+   pane_damage_rows(&p, 7, 7);
+   TEST_CHECK(p.damage_from >= p.damage_to);
+
+   pane_damage_rows(&p, 7, 8);
+   pane_damage_rows(&p, 3, 4);
+   TEST_CHECK(p.damage_from == 3 && p.damage_to == 8);
+
+   pane_damage_all(&p);
+   TEST_CHECK(p.damage_from == 0 && p.damage_to == max_U64);
+
+   free_arena(&c.arena, c.arena.size);
+}
@@ -0,0 +1,140 @@
+#include "editor/parse_worker.h"
+
+#include "editor/parse_worker.cpp"
+
+// the whole text a TSInput would see
+intern String8
+test_read_parse_text(ParseText *t, Arena *a)
+{
+   String8 s = {};
+   s.ptr = push_array(a, U8, 256);
+
+   for (;;) {
+      U32 read = 0;
+      const char *chunk = parse_text_read(t, (U32) s.len, {}, &read);
+      if (!read || s.len + read > 256) {
+         break;
+      }
+
+      MEM_COPY(s.ptr + s.len, chunk, read);
+      s.len += read;
+   }
+
+   return s;
+}
+
+intern void
+test_parse_worker()
+{
+   Arena arena = {};
+   init_arena(&arena, MEGA_BYTES(2));
+
+   Arena buf_arena = {};
+   sub_arena(&buf_arena, &arena, MEGA_BYTES(1) / 4);
+
+   TextBuffer buf = text_buffer_from_arena(buf_arena, BUFFER_GAP);
+   insert_string(&buf, String8("int main() { return 0; }"), 0);
+
+   // no language is set, so the worker never finishes a tree and this only
+   // covers the hand over between the threads
+   ParseWorker *w = parse_worker_start(0);
+
+   // Test 1: Edits wait until the next submit and are logged by generation
+   TSInputEdit edit = {};
+   edit.start_byte = 4;
+   edit.old_end_byte = 4;
+   edit.new_end_byte = 5;
+   parse_worker_edit(w, edit);
+   parse_worker_edit(w, edit);
+
+   TEST_CHECK(w->pending_count == 2);
+   TEST_CHECK(w->log_count == 2 && w->log_generation[1] == 1);
+
+   parse_worker_submit(w, &buf);
+   TEST_CHECK(w->pending_count == 0);
+   TEST_CHECK(w->submitted == 1 && w->submitted_len == buf.len);
+
+   parse_worker_edit(w, edit);
+   TEST_CHECK(w->log_generation[2] == 2);
+
+   TEST_CHECK(parse_worker_take(w) == 0);
+
+   // Test 2: Stopping joins the worker even with a job queued
+   parse_worker_submit(w, &buf);
+   parse_worker_stop(w);
+
+   Arena text_arena = {};
+   String8 text = {};
+   ParseSnapshot snapshot = {};
+
+   // Test 3: A gap buffer is copied whole once, then only the edited bytes
+   Arena gap_arena = {};
+   sub_arena(&gap_arena, &arena, MEGA_BYTES(1) / 4);
+
+   TextBuffer gap = text_buffer_from_arena(gap_arena, BUFFER_GAP);
+   insert_string(&gap, String8("int main() { return 0; }"), 0);
+
+   parse_snapshot_gap(&snapshot, &gap.gap, 0, 0);
+   TEST_CHECK(snapshot.middle.len == gap.len);
+
+   ParseText t = parse_snapshot_text(&snapshot, &text_arena, &text);
+   TEST_CHECK(test_read_parse_text(&t, &arena) == String8("int main() { return 0; }"));
+
+   U64 base_len = gap.len;
+   insert_char(&gap, 'x', 4);
+   delete_char(&gap, 10);
+
+   parse_snapshot_gap(&snapshot, &gap.gap, base_len, 0);
+   TEST_CHECK(snapshot.keep_before == 4 && snapshot.keep_after == 14);
+   TEST_CHECK(snapshot.middle == String8("xmain("));
+
+   t = parse_snapshot_text(&snapshot, &text_arena, &text);
+   TEST_CHECK(test_read_parse_text(&t, &arena) == String8("int xmain( { return 0; }"));
+
+   // Test 4: A patch the worker did not take is merged into the next one
+   base_len = gap.len;
+   insert_char(&gap, 'a', 0);
+   parse_snapshot_gap(&snapshot, &gap.gap, base_len, 0);
+
+   insert_char(&gap, 'z', gap.len);
+   parse_snapshot_gap(&snapshot, &gap.gap, gap.len - 1, 1);
+   TEST_CHECK(snapshot.base_len == base_len);
+
+   t = parse_snapshot_text(&snapshot, &text_arena, &text);
+   TEST_CHECK(test_read_parse_text(&t, &arena) == String8("aint xmain( { return 0; }z"));
+
+   // Test 5: Piece tree snapshots keep reading the text of their time
+   Arena tree_arena = {};
+   sub_arena(&tree_arena, &arena, MEGA_BYTES(1) / 4);
+
+   TextBuffer tree = text_buffer_from_arena(tree_arena, BUFFER_PIECE_TREE);
+   insert_string(&tree, String8("int main() { return 0; }"), 0);
+   insert_char(&tree, 'x', 4);
+
+   ParseSnapshot pieces = {};
+   parse_snapshot_pieces(&pieces, &tree.tree);
+   TEST_CHECK(pieces.piece_count == 3);
+
+   delete_chars(&tree, 0, 4);
+   insert_char(&tree, 'y', 2);
+
+   t = parse_snapshot_text(&pieces, &text_arena, &text);
+   TEST_CHECK(test_read_parse_text(&t, &arena) == String8("int xmain() { return 0; }"));
+
+   // reads can start anywhere in a piece
+   U32 read = 0;
+   const char *chunk = parse_text_read(&t, 6, {}, &read);
+   TEST_CHECK(read == 19 && chunk[0] == 'a');
+
+   chunk = parse_text_read(&t, 2, {}, &read);
+   TEST_CHECK(read == 2 && chunk[0] == 't');
+
+   parse_text_read(&t, 25, {}, &read);
+   TEST_CHECK(read == 0);
+
+   text_buffer_release(&tree);
+   free_arena(&pieces.arena, pieces.arena.size);
+   free_arena(&snapshot.arena, snapshot.arena.size);
+   free_arena(&text_arena, text_arena.size);
+   free_arena(&arena, arena.size);
+}
@@ -0,0 +1,256 @@
+#include "editor/piece_tree.h"
+
+#include "editor/piece_tree.cpp"
+
+intern void
+test_piece_tree()
+{
+   Arena arena = {};
+   init_arena(&arena, MEGA_BYTES(16));
+
+   Arena tree_arena = {};
+   sub_arena(&tree_arena, &arena, MEGA_BYTES(1));
+
+   Arena random_arena = {};
+   sub_arena(&random_arena, &arena, MEGA_BYTES(1));
+
+   Arena gap_arena = {};
+   sub_arena(&gap_arena, &arena, MEGA_BYTES(1));
+
+   TempArena temp_arena = begin_temp_arena(&arena);
+
+   PieceTree pt = piece_tree_from_arena(tree_arena);
+
+   // Test 1: Insert
+   String8 s1("Hello");
+   insert_string(&pt, s1, 0);
+   TEST_CHECK(pt.len == s1.len);
+   TEST_CHECK(pt[0] == s1[0]);
+   TEST_CHECK(pt[s1.len - 1] == s1[s1.len - 1]);
+
+   // Test 2: Insert at middle and typing at the end of a piece
+   insert_string(&pt, String8(", World"), 5);
+   U64 pos = insert_char(&pt, '!', pt.len);
+   TEST_CHECK(pos == pt.len);
+
+   String8 result = str8_from_piece_tree(&pt, temp_arena.arena);
+   TEST_CHECK(result == String8("Hello, World!"));
+
+   // Test 3: Insert inside a piece
+   insert_string(&pt, String8("XY"), 2);
+   result = str8_from_piece_tree(&pt, temp_arena.arena);
+   TEST_CHECK(result == String8("HeXYllo, World!"));
+
+   // Test 4: Delete across pieces
+   delete_chars(&pt, 1, 4);
+   result = str8_from_piece_tree(&pt, temp_arena.arena);
+   TEST_CHECK(result == String8("Hlo, World!"));
+
+   // Test 5: UTF-8 character insertion and deletion
+   insert_string(&pt, String8("🌍"), 3);
+   TEST_CHECK(pt.len == 15);
+   delete_char(&pt, 3);
+   result = str8_from_piece_tree(&pt, temp_arena.arena);
+   TEST_CHECK(result == String8("Hlo, World!"));
+
+   // Test 6: Random edits match the gap buffer
+   PieceTree rt = piece_tree_from_arena(random_arena);
+   GapBuffer gb = gap_buffer_from_arena(gap_arena);
+
+   U32 seed = 1234;
+   for (U32 i = 0; i < 2000; ++i) {
+      seed = seed * 1664525 + 1013904223;
+      U64 at = gb.len ? (seed >> 8) % (gb.len + 1) : 0;
+
+      if ((seed & 3) != 0 || gb.len < 8) {
+         String8 word("abc\n");
+         word.len = 1 + (seed >> 4) % 4;
+         insert_string(&rt, word, at);
+         insert_string(&gb, word, at);
+      } else {
+         U64 n = 1 + (seed >> 4) % 5;
+         delete_chars(&rt, at, n);
+         delete_chars(&gb, at, n);
+      }
+   }
+
+   TEST_CHECK(rt.len == gb.len);
+   TEST_CHECK(str8_from_piece_tree(&rt, temp_arena.arena) == str8_from_gap_buffer(&gb, temp_arena.arena));
+
+   B32 same = 1;
+   for (U64 i = 0; i < gb.len; ++i) {
+      same &= rt[i] == gb[i];
+   }
+   TEST_CHECK(same);
+
+   // nodes cut out by the deletes went back to the pool
+   String8 *rt_pieces = push_array(temp_arena.arena, String8, rt.nodes.live_count + 1);
+   TEST_CHECK(piece_tree_pieces(&rt, rt_pieces) == rt.nodes.live_count);
+
+   // Test 7: Line indices of both backends agree with a plain scan
+   B32 lines_ok = 1;
+   U64 newlines = 0;
+   for (U64 i = 0; i <= gb.len; ++i) {
+      lines_ok &= gap_buffer_newlines_before(&gb, i) == newlines;
+      lines_ok &= piece_tree_newlines_before(&rt, i) == newlines;
+
+      if (i < gb.len && gb[i] == '\n') {
+         lines_ok &= gap_buffer_newline_offset(&gb, newlines) == i;
+         lines_ok &= piece_tree_newline_offset(&rt, newlines) == i;
+         newlines++;
+      }
+   }
+   TEST_CHECK(lines_ok);
+   TEST_CHECK(gap_buffer_newline_count(&gb) == newlines);
+   TEST_CHECK(piece_tree_newline_count(&rt) == newlines);
+
+   // Test 8: Mapped file, LF pages stay in the mapping, CRLF pages are stripped
+   U8 *content = push_array(temp_arena.arena, U8, 3 * PIECE_MAX_LEN);
+   for (U64 i = 0; i < 3 * PIECE_MAX_LEN; ++i) {
+      content[i] = (i % 8 == 7) ? '\n' : 'a';
+   }
+   content[PIECE_MAX_LEN + 6] = '\r';
+   content[2 * PIECE_MAX_LEN - 1] = '\r';
+
+   const char *mapped_path = "test_piece_tree_mapped.tmp";
+   FILE *f = fopen(mapped_path, "wb");
+   fwrite(content, 1, 3 * PIECE_MAX_LEN, f);
+   fclose(f);
+
+   Arena mapped_arena = {};
+   sub_arena(&mapped_arena, &arena, MEGA_BYTES(1) / 2);
+
+   TextBuffer mb = text_buffer_from_arena(mapped_arena, BUFFER_PIECE_TREE);
+   load_source_file(&mb, os_map_file(String8(mapped_path)));
+   PieceTree *mt = &mb.tree;
+
+   TEST_CHECK(mt->file.len == 3 * PIECE_MAX_LEN);
+   TEST_CHECK(mt->len == 3 * PIECE_MAX_LEN - 2);
+   TEST_CHECK(mt->add_len == PIECE_MAX_LEN - 2);
+   TEST_CHECK(piece_tree_chunk_at(mt, 0).ptr == mt->file.ptr);
+   TEST_CHECK(piece_tree_chunk_at(mt, 2 * PIECE_MAX_LEN - 2).ptr == mt->file.ptr + 2 * PIECE_MAX_LEN);
+   TEST_CHECK(piece_tree_newline_count(mt) == 3 * PIECE_MAX_LEN / 8 - 1);
+
+   String8 loaded = str8_from_piece_tree(mt, temp_arena.arena);
+   B32 stripped = loaded.len == mt->len;
+   for (U64 i = 0, j = 0; stripped && i < 3 * PIECE_MAX_LEN; ++i) {
+      if (content[i] != '\r') {
+         stripped &= loaded[j++] == content[i];
+      }
+   }
+   TEST_CHECK(stripped);
+
+   // edits go to the add buffer behind the copied page
+   insert_string(&mb, String8("xyz"), 5);
+   TEST_CHECK(mt->add_len == PIECE_MAX_LEN + 1);
+   TEST_CHECK(mb[5] == 'x' && mb[8] == 'a');
+
+   text_buffer_release(&mb);
+
+   // mostly LF, the single CRLF does not change the style
+
+   Arena lf_arena = {};
+   sub_arena(&lf_arena, &arena, MEGA_BYTES(1) / 4);
+
+   TextBuffer lf = text_buffer_from_arena(lf_arena, BUFFER_PIECE_TREE);
+   load_source_file(&lf, os_map_file(String8(mapped_path)));
+   TEST_CHECK(lf.len == 3 * PIECE_MAX_LEN - 2);
+   TEST_CHECK(lf.line_ending == LINE_ENDING_LF);
+   text_buffer_release(&lf);
+
+   // Test 9: Loading on a worker gives the same buffer, cancelling stops it
+   U64 big_len = 300 * PIECE_MAX_LEN + 123;
+   U8 *big = push_array(temp_arena.arena, U8, big_len);
+   for (U64 i = 0; i < big_len; ++i) {
+      seed = seed * 1664525 + 1013904223;
+      U32 r = (seed >> 8) % 40;
+      big[i] = r == 0 ? '\r' : r == 1 ? '\n' : (U8)('a' + r);
+   }
+
+   f = fopen(mapped_path, "wb");
+   fwrite(big, 1, big_len, f);
+   fclose(f);
+
+   Arena load_arena = {};
+   init_arena(&load_arena, MEGA_BYTES(16));
+
+   B32 threaded_same = 1;
+   for (U32 backend = BUFFER_GAP; backend <= BUFFER_PIECE_TREE; ++backend) {
+      Arena sync_arena = {};
+      sub_arena(&sync_arena, &load_arena, MEGA_BYTES(4));
+      Arena async_arena = {};
+      sub_arena(&async_arena, &load_arena, MEGA_BYTES(4));
+
+      TextBuffer sync = text_buffer_from_arena(sync_arena, backend);
+      load_source_file(&sync, os_map_file(String8(mapped_path)));
+
+      TextBuffer async = text_buffer_from_arena(async_arena, backend);
+      BufferLoad *load = buffer_load_begin(&async, os_map_file(String8(mapped_path)), 1);
+      TEST_CHECK(async.loading);
+
+      U64 prev_len = 0;
+      while (!buffer_load_poll(load, &async)) {
+         threaded_same &= async.len >= prev_len;
+         prev_len = async.len;
+      }
+
+      threaded_same &= !async.loading;
+      threaded_same &= async.len == sync.len;
+      threaded_same &= async.line_ending == sync.line_ending;
+      threaded_same &= buffer_line_count(&async) == buffer_line_count(&sync);
+      threaded_same &= str8_from_buffer(&async, temp_arena.arena) == str8_from_buffer(&sync, temp_arena.arena);
+
+      text_buffer_release(&sync);
+      text_buffer_release(&async);
+      load_arena.top = 0;
+   }
+   TEST_CHECK(threaded_same);
+
+   TextBuffer cancelled = text_buffer_from_arena(load_arena, BUFFER_GAP);
+   BufferLoad *load = buffer_load_begin(&cancelled, os_map_file(String8(mapped_path)), 1);
+   buffer_load_cancel(load, &cancelled);
+   TEST_CHECK(!cancelled.loading);
+   TEST_CHECK(insert_char(&cancelled, 'a', 0) == 1);
+
+   free_arena(&load_arena, load_arena.size);
+   remove(mapped_path);
+
+   // Test 10: Motions at the end of the buffer and in an empty one stay inside it
+   Arena motion_arena = {};
+   init_arena(&motion_arena, MEGA_BYTES(4));
+
+   B32 motions_ok = 1;
+   for (U32 backend = BUFFER_GAP; backend <= BUFFER_PIECE_TREE; ++backend) {
+      Arena text_arena = {};
+      sub_arena(&text_arena, &motion_arena, MEGA_BYTES(1));
+      Arena empty_arena = {};
+      sub_arena(&empty_arena, &motion_arena, MEGA_BYTES(1));
+
+      TextBuffer mb = text_buffer_from_arena(text_arena, backend);
+      insert_string(&mb, String8("ab cd"), 0);
+
+      motions_ok &= cursor_next_normal(&mb, mb.len - 1) <= mb.len;
+      motions_ok &= cursor_next_word(&mb, 3) == mb.len;
+      motions_ok &= cursor_next_word(&mb, mb.len) == mb.len;
+      motions_ok &= cursor_end_of_word(&mb, 3) == 4;
+      motions_ok &= cursor_end_of_word(&mb, mb.len) <= mb.len;
+      motions_ok &= cursor_prev_word(&mb, mb.len) < mb.len;
+
+      TextBuffer empty = text_buffer_from_arena(empty_arena, backend);
+      motions_ok &= cursor_next_normal(&empty, 0) == 0;
+      motions_ok &= cursor_next_word(&empty, 0) == 0;
+      motions_ok &= cursor_end_of_word(&empty, 0) == 0;
+      motions_ok &= cursor_prev_word(&empty, 0) == 0;
+      motions_ok &= insert_line(&empty, 0, 1) == 1;
+
+      text_buffer_release(&mb);
+      text_buffer_release(&empty);
+      motion_arena.top = 0;
+   }
+   TEST_CHECK(motions_ok);
+
+   free_arena(&motion_arena, motion_arena.size);
+
+   end_temp_arena(temp_arena);
+   free_arena(&arena, arena.size);
+}
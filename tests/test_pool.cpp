@@ -0,0 +1,139 @@
+#include "base/base_inc.h"
+
+enum
+{
+   TEST_POOL_THREADS = 4,
+   TEST_POOL_ITEMS = 1000,
+};
+
+struct TestPoolItem
+{
+   U64 owner;
+   U64 index;
+   U8 payload[40];
+};
+
+struct TestPoolThread
+{
+   Pool *pool;
+   U64 owner;
+   B32 ok;
+};
+
+intern void
+test_pool_thread(void *param)
+{
+   TestPoolThread *t = (TestPoolThread *) param;
+   PoolCache cache = pool_cache(t->pool);
+
+   TestPoolItem *items[TEST_POOL_ITEMS];
+   t->ok = 1;
+
+   for (U32 round = 0; round < 20; ++round) {
+      for (U32 i = 0; i < TEST_POOL_ITEMS; ++i) {
+         items[i] = pool_cache_alloc_struct(&cache, TestPoolItem);
+         items[i]->owner = t->owner;
+         items[i]->index = i;
+      }
+
+      // an item handed to two threads would be overwritten by the other one
+      for (U32 i = 0; i < TEST_POOL_ITEMS; ++i) {
+         t->ok &= items[i]->owner == t->owner && items[i]->index == i;
+      }
+
+      for (U32 i = 0; i < TEST_POOL_ITEMS; ++i) {
+         pool_cache_free(&cache, items[(i * 7) % TEST_POOL_ITEMS]);
+      }
+   }
+
+   pool_cache_flush(&cache);
+}
+
+intern void
+test_pool()
+{
+   Arena arena = {};
+   init_arena(&arena, MEGA_BYTES(64));
+
+   // Test 1: Freed items are reused before the arena grows
+   Arena items_arena = {};
+   sub_arena(&items_arena, &arena, MEGA_BYTES(1));
+
+   Pool pool = {};
+   init_pool_of(&pool, items_arena, TestPoolItem);
+   TEST_CHECK(pool.item_size == sizeof(TestPoolItem));
+
+   TestPoolItem *a = pool_alloc_struct(&pool, TestPoolItem);
+   TestPoolItem *b = pool_alloc_struct(&pool, TestPoolItem);
+   TEST_CHECK(a != b);
+   TEST_CHECK(pool.live_count == 2);
+
+   U64 top = pool.arena.top;
+   pool_free(&pool, a);
+   TEST_CHECK(pool.free_count == 1 && pool.live_count == 1);
+
+   TestPoolItem *c = pool_alloc_struct(&pool, TestPoolItem);
+   TEST_CHECK(c == a);
+   TEST_CHECK(pool.arena.top == top && pool.free_count == 0);
+
+   // Test 2: Small items still hold the free list link
+   Arena small_arena = {};
+   sub_arena(&small_arena, &arena, MEGA_BYTES(1));
+
+   Pool small = {};
+   init_pool(&small, small_arena, 3);
+   TEST_CHECK(small.item_size == 8);
+
+   // Test 3: Caches move whole batches and give everything back on a flush
+   PoolCache cache = pool_cache(&pool);
+   TestPoolItem *cached = pool_cache_alloc_struct(&cache, TestPoolItem);
+   TEST_CHECK(cached);
+   TEST_CHECK(cache.count == POOL_CACHE_BATCH - 1);
+   TEST_CHECK(pool.live_count == 2 + POOL_CACHE_BATCH);
+
+   TestPoolItem *many[3 * POOL_CACHE_BATCH];
+   for (U32 i = 0; i < ARRAY_COUNT(many); ++i) {
+      many[i] = pool_cache_alloc_struct(&cache, TestPoolItem);
+   }
+   for (U32 i = 0; i < ARRAY_COUNT(many); ++i) {
+      pool_cache_free(&cache, many[i]);
+   }
+   TEST_CHECK(cache.count < 2 * POOL_CACHE_BATCH);
+   TEST_CHECK(pool.live_count == 3 + cache.count);
+
+   pool_cache_free(&cache, cached);
+   pool_cache_flush(&cache);
+   TEST_CHECK(cache.count == 0 && !cache.free);
+   TEST_CHECK(pool.live_count == 2);
+
+   release_pool(&pool);
+   release_pool(&small);
+
+   // Test 4: Threads with their own caches never get the same item
+   Arena shared_arena = {};
+   sub_arena(&shared_arena, &arena, MEGA_BYTES(16));
+
+   Pool shared = {};
+   init_pool_of(&shared, shared_arena, TestPoolItem, 1);
+
+   TestPoolThread threads[TEST_POOL_THREADS] = {};
+   OS_Handle handles[TEST_POOL_THREADS];
+   for (U32 i = 0; i < TEST_POOL_THREADS; ++i) {
+      threads[i].pool = &shared;
+      threads[i].owner = i + 1;
+      handles[i] = os_thread_start(test_pool_thread, &threads[i]);
+   }
+
+   B32 threads_ok = 1;
+   for (U32 i = 0; i < TEST_POOL_THREADS; ++i) {
+      os_thread_join(handles[i]);
+      threads_ok &= threads[i].ok;
+   }
+   TEST_CHECK(threads_ok);
+   TEST_CHECK(shared.live_count == 0);
+   TEST_CHECK(shared.arena.top <= (TEST_POOL_THREADS * TEST_POOL_ITEMS + TEST_POOL_THREADS * 2 * POOL_CACHE_BATCH) * shared.item_size);
+
+   release_pool(&shared);
+
+   free_arena(&arena, arena.size);
+}
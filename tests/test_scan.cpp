@@ -0,0 +1,95 @@
+#include "math/scan_inc.h"
+
+intern void
+test_scan()
+{
+   U8 text[300];
+
+   // Test 1: Kernels agree with the scalar versions for every length and offset
+   U32 seed = 99;
+   for (U32 i = 0; i < sizeof(text); ++i) {
+      seed = seed * 1664525 + 1013904223;
+      text[i] = ((seed >> 8) % 7 == 0) ? '\n' : 'a';
+   }
+
+   B32 same = 1;
+   for (U64 off = 0; off < 40; ++off) {
+      for (U64 len = 0; off + len <= sizeof(text); ++len) {
+         U8 *p = text + off;
+         same &= count_newlines(p, len) == count_newlines_scalar(p, len);
+         same &= find_newline(p, len) == find_newline_scalar(p, len);
+         same &= find_newline_reverse(p, len) == find_newline_reverse_scalar(p, len);
+         same &= find_double_newline(p, len) == find_double_newline_scalar(p, len);
+      }
+   }
+   TEST_CHECK(same);
+
+   // Test 2: Nothing to find
+   MEM_SET(text, 'b', sizeof(text));
+   TEST_CHECK(count_newlines(text, sizeof(text)) == 0);
+   TEST_CHECK(find_newline(text, sizeof(text)) == sizeof(text));
+   TEST_CHECK(find_newline_reverse(text, sizeof(text)) == sizeof(text));
+   TEST_CHECK(find_double_newline(text, sizeof(text)) == sizeof(text));
+
+   // Test 3: Buffer scans see a pair split by the gap
+   Arena arena = {};
+   init_arena(&arena, MEGA_BYTES(1));
+
+   TextBuffer buf = text_buffer_from_arena(arena, BUFFER_GAP);
+   insert_string(&buf, String8("abc\n\ndef\nghi"), 0);
+   insert_char(&buf, 'x', 4);  // gap now sits between the two newlines
+
+   TEST_CHECK(buffer_find_double_newline(&buf, 0) == buf.len);
+   delete_char(&buf, 4);
+   TEST_CHECK(buf.gap.start == 4);
+   TEST_CHECK(buffer_find_double_newline(&buf, 0) == 3);
+   TEST_CHECK(buffer_find_newline(&buf, 5) == 8);
+   TEST_CHECK(buffer_find_newline_reverse(&buf, 8) == 4);
+   TEST_CHECK(cursor_line_begin(&buf, 10) == 9);
+   TEST_CHECK(cursor_line_end(&buf, 0) == 3);
+
+   // Test 4: Carriage return stripping matches the scalar loop, also in place
+   U8 expect[sizeof(text)];
+   U8 stripped[sizeof(text)];
+   B32 strip_same = 1;
+   for (U32 density = 1; density < 20; density += 3) {
+      for (U32 i = 0; i < sizeof(text); ++i) {
+         seed = seed * 1664525 + 1013904223;
+         text[i] = ((seed >> 8) % density == 0) ? '\r' : (U8)('a' + i % 26);
+      }
+
+      for (U64 off = 0; off < 20; ++off) {
+         U64 len = sizeof(text) - off;
+         U64 n = strip_cr_scalar(expect, text + off, len);
+
+         strip_same &= strip_cr(stripped, text + off, len) == n;
+         strip_same &= MEM_CMP(stripped, expect, n) == 0;
+      }
+
+      U64 n = strip_cr_scalar(expect, text, sizeof(text));
+      strip_same &= strip_cr(text, text, sizeof(text)) == n;
+      strip_same &= MEM_CMP(text, expect, n) == 0;
+   }
+   TEST_CHECK(strip_same);
+
+   // Test 5: Loading a CRLF file strips it and remembers the line ending
+   const char *crlf_path = "test_scan_crlf.tmp";
+   FILE *f = fopen(crlf_path, "wb");
+   fputs("one\r\ntwo\r\nthree\n", f);
+   fclose(f);
+
+   Arena load_arena = {};
+   sub_arena(&load_arena, &arena, KILO_BYTES(64));
+
+   TextBuffer crlf = text_buffer_from_arena(load_arena, BUFFER_GAP);
+   load_source_file(&crlf, os_map_file(String8(crlf_path)));
+   remove(crlf_path);
+
+   TempArena temp = begin_temp_arena(&arena);
+   TEST_CHECK(str8_from_buffer(&crlf, temp.arena) == String8("one\ntwo\nthree\n"));
+   TEST_CHECK(crlf.line_ending == LINE_ENDING_CRLF);
+   TEST_CHECK(buffer_line_begin(&crlf, 2) == 8);
+   end_temp_arena(temp);
+
+   free_arena(&arena, arena.size);
+}
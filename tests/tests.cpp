@@ -1,3 +1,6 @@
+// the arena instrumentation is tested along with the arenas
+#define ARENA_STATS 1
+
 #include "base/base_inc.h"
 #include "base/base_inc.cpp"
 
@@ -12,13 +15,25 @@ static U32 g_failed_tests = 0;
    } while (0);
 
 #include "test_string.cpp"
+#include "test_arena.cpp"
+#include "test_pool.cpp"
  #include "test_gap_buffer.cpp"
+#include "test_piece_tree.cpp"
+#include "test_scan.cpp"
+#include "test_parse_worker.cpp"
+#include "test_highlight.cpp"
 
 int
 main(int argc, char **argv)
 {
    test_string();
+   test_arena();
+   test_pool();
    test_gap_buffer();
+   test_piece_tree();
+   test_scan();
+   test_parse_worker();
+   test_highlight();
 
    if (g_failed_tests == 0) {
       log_info("All tests passed successfully!");